@@ -0,0 +1,117 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+namespace arap
+{
+	// Clock reads in nanoseconds. The coarse ones are updated on the scheduler tick only (1-4 ms),
+	// but never leave the vDSO. The cached ones are per thread and move only when the owning
+	// event loop calls refresh(), usually once per iteration.
+	class Clock
+	{
+	public:
+		static const int64_t nanosecondsPerSecond = 1000000000;
+
+		static int64_t monotonic() { return read(CLOCK_MONOTONIC); }
+		static int64_t monotonicCoarse() { return read(CLOCK_MONOTONIC_COARSE); }
+		static int64_t realtime() { return read(CLOCK_REALTIME); }
+		static int64_t realtimeCoarse() { return read(CLOCK_REALTIME_COARSE); }
+
+		static void refresh()
+		{
+			auto& values = cache();
+			values.monotonic = monotonic();
+			values.realtime = realtime();
+			values.refreshed = true;
+		}
+
+		// Refreshed on the first use in a thread.
+		static int64_t cachedMonotonic()
+		{
+			if (!cache().refreshed)
+				refresh();
+
+			return cache().monotonic;
+		}
+
+		static int64_t cachedRealtime()
+		{
+			if (!cache().refreshed)
+				refresh();
+
+			return cache().realtime;
+		}
+
+		static int64_t read(clockid_t clockId)
+		{
+			struct timespec time;
+			clock_gettime(clockId, &time);
+
+			return static_cast<int64_t>(time.tv_sec) * nanosecondsPerSecond + time.tv_nsec;
+		}
+	private:
+		struct Cache
+		{
+			int64_t monotonic;
+			int64_t realtime;
+			bool refreshed;
+		};
+
+		static Cache& cache()
+		{
+			thread_local Cache values = {0, 0, false};
+			return values;
+		}
+
+		Clock(){}
+		~Clock(){}
+	};
+
+	// Clock policies for the timer templates. Second resolution timers use seconds(),
+	// sub-second ones nanoseconds().
+	namespace clocks
+	{
+		const int64_t nanosecondsPerSecond = Clock::nanosecondsPerSecond;
+
+		template <int64_t (*read)()>
+		struct Reader
+		{
+			static int64_t nanoseconds() { return read(); }
+			static time_t seconds() { return static_cast<time_t>(read() / nanosecondsPerSecond); }
+		};
+
+		// Wall clock through std::time(), what the timers have always been using.
+		struct System
+		{
+			static int64_t nanoseconds() { return Clock::realtime(); }
+			static time_t seconds() { return std::time(nullptr); }
+		};
+
+		using Monotonic = Reader<Clock::monotonic>;
+		using MonotonicCoarse = Reader<Clock::monotonicCoarse>;
+		using RealtimeCoarse = Reader<Clock::realtimeCoarse>;
+
+		// The event loop thread has to call Clock::refresh() for these to move.
+		using CachedMonotonic = Reader<Clock::cachedMonotonic>;
+		using CachedRealtime = Reader<Clock::cachedRealtime>;
+
+		// Moves only when told to, for tests and for benchmarking the timer logic alone.
+		// The state is shared by every timer using this policy.
+		struct Manual
+		{
+			static int64_t nanoseconds() { return now(); }
+			static time_t seconds() { return static_cast<time_t>(now() / nanosecondsPerSecond); }
+
+			static void set(int64_t nanoseconds) { now() = nanoseconds; }
+			static void advance(std::chrono::nanoseconds duration) { now() += duration.count(); }
+		private:
+			static int64_t& now()
+			{
+				static int64_t current = nanosecondsPerSecond;
+				return current;
+			}
+		};
+	}
+}
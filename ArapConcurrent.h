@@ -0,0 +1,306 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace arap
+{
+	namespace concurrent
+	{
+		// Bounded lock-free queue for many producers and a single consumer, D. Vyukov's
+		// ring of sequenced cells. Capacity is rounded up to a power of two.
+		template <typename T>
+		class MpscQueue
+		{
+		public:
+			MpscQueue(size_t capacity) : m_mask(roundUp(capacity) - 1), m_cells(new Cell[m_mask + 1]),
+				m_enqueuePosition(0), m_dequeuePosition(0)
+			{
+				for (size_t i = 0; i <= m_mask; i++)
+					m_cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+
+			// False when the queue is full, the value is left untouched then.
+			bool tryPush(T&& value)
+			{
+				size_t position;
+				auto cell = claim(position);
+				if (cell == nullptr)
+					return false;
+
+				cell->value = std::move(value);
+				cell->sequence.store(position + 1, std::memory_order_release);
+
+				return true;
+			}
+
+			bool tryPush(const T& value)
+			{
+				T copy(value);
+				return tryPush(std::move(copy));
+			}
+
+			// Consumer side only.
+			bool tryPop(T& value)
+			{
+				auto& cell = m_cells[m_dequeuePosition & m_mask];
+				auto sequence = cell.sequence.load(std::memory_order_acquire);
+
+				if (sequence != m_dequeuePosition + 1)
+					return false;
+
+				value = std::move(cell.value);
+				cell.value = T();
+				cell.sequence.store(m_dequeuePosition + m_mask + 1, std::memory_order_release);
+				m_dequeuePosition++;
+
+				return true;
+			}
+
+			// Exact on the consumer side, a hint anywhere else.
+			bool empty() const
+			{
+				auto& cell = m_cells[m_dequeuePosition & m_mask];
+				return cell.sequence.load(std::memory_order_acquire) != m_dequeuePosition + 1;
+			}
+
+			size_t capacity() const { return m_mask + 1; }
+
+			MpscQueue(const MpscQueue&) = delete;
+			MpscQueue& operator=(const MpscQueue&) = delete;
+
+			~MpscQueue(){}
+		private:
+			struct Cell
+			{
+				std::atomic<size_t> sequence;
+				T value;
+			};
+
+			static size_t roundUp(size_t capacity)
+			{
+				size_t rounded = 2;
+				while (rounded < capacity)
+					rounded <<= 1;
+
+				return rounded;
+			}
+
+			const size_t m_mask;
+			std::unique_ptr<Cell[]> m_cells;
+			// Producers and the consumer on separate cache lines.
+			char m_producerPadding[64];
+			std::atomic<size_t> m_enqueuePosition;
+			char m_consumerPadding[64];
+			size_t m_dequeuePosition;
+
+			Cell* claim(size_t& position)
+			{
+				position = m_enqueuePosition.load(std::memory_order_relaxed);
+				while (true)
+				{
+					auto& cell = m_cells[position & m_mask];
+					auto sequence = cell.sequence.load(std::memory_order_acquire);
+					auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+					if (difference == 0)
+					{
+						if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+							return &cell;
+					}
+					else if (difference < 0)
+					{
+						return nullptr;
+					}
+					else
+					{
+						position = m_enqueuePosition.load(std::memory_order_relaxed);
+					}
+				}
+			}
+		};
+
+		// Fixed set of worker threads running the submitted jobs in the order of submission.
+		class ThreadPool
+		{
+		public:
+			// Jobs of one caller, waited for apart from the rest of the pool. The waiting thread runs the
+			// jobs of the group still queued itself, so it is safe to wait from inside a job of the same pool.
+			class Group
+			{
+			public:
+				explicit Group(ThreadPool& pool) : m_pool(pool), m_pending(0)
+				{}
+
+				void submit(std::function<void()> job) { m_pool.push(std::move(job), this); }
+
+				// Blocks until the jobs of the group have finished, rethrows the first exception thrown by them.
+				void wait()
+				{
+					std::unique_lock<std::mutex> lock(m_pool.m_mutex);
+					while (m_pending > 0)
+					{
+						auto queued = std::find_if(m_pool.m_jobs.begin(), m_pool.m_jobs.end(), [this](const Job& job) { return job.group == this; });
+						if (queued == m_pool.m_jobs.end())
+						{
+							m_pool.m_idle.wait(lock);
+							continue;
+						}
+
+						auto job = std::move(*queued);
+						m_pool.m_jobs.erase(queued);
+						m_pool.run(lock, job);
+					}
+
+					if (m_failure)
+						std::rethrow_exception(std::exchange(m_failure, nullptr));
+				}
+
+				Group(const Group&) = delete;
+				Group& operator=(const Group&) = delete;
+
+				// Jobs still pending are waited for, their exceptions are lost.
+				~Group()
+				{
+					try
+					{
+						wait();
+					}
+					catch (...)
+					{}
+				}
+			private:
+				friend class ThreadPool;
+
+				ThreadPool& m_pool;
+				size_t m_pending;
+				std::exception_ptr m_failure;
+			};
+
+			explicit ThreadPool(size_t threads = std::thread::hardware_concurrency()) : m_active(0), m_stopping(false)
+			{
+				if (threads == 0)
+					threads = 1;
+
+				for (size_t i = 0; i < threads; i++)
+					m_workers.emplace_back(&ThreadPool::work, this);
+			}
+
+			void submit(std::function<void()> job) { push(std::move(job), nullptr); }
+
+			// Blocks until every submitted job has finished, rethrows the first exception thrown by them.
+			// Jobs of a group report their exceptions to the group. Never returns when called from a job,
+			// use a Group there.
+			void wait()
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_idle.wait(lock, [this]() { return m_jobs.empty() && m_active == 0; });
+
+				if (m_failure)
+					std::rethrow_exception(std::exchange(m_failure, nullptr));
+			}
+
+			size_t size() const { return m_workers.size(); }
+
+			ThreadPool(const ThreadPool&) = delete;
+			ThreadPool& operator=(const ThreadPool&) = delete;
+
+			// Jobs still queued are run before the workers exit.
+			~ThreadPool()
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_stopping = true;
+				}
+
+				m_jobAvailable.notify_all();
+				for (auto& worker : m_workers)
+					worker.join();
+			}
+		private:
+			struct Job
+			{
+				std::function<void()> function;
+				Group* group;
+			};
+
+			std::vector<std::thread> m_workers;
+			std::deque<Job> m_jobs;
+			std::mutex m_mutex;
+			std::condition_variable m_jobAvailable;
+			std::condition_variable m_idle;
+			size_t m_active;
+			bool m_stopping;
+			std::exception_ptr m_failure;
+
+			void push(std::function<void()> function, Group* group)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_jobs.push_back(Job{std::move(function), group});
+					if (group)
+						group->m_pending++;
+				}
+
+				m_jobAvailable.notify_one();
+			}
+
+			// Called and returns with the lock held, the job runs without it.
+			void run(std::unique_lock<std::mutex>& lock, Job& job)
+			{
+				m_active++;
+				lock.unlock();
+
+				std::exception_ptr failure;
+				try
+				{
+					job.function();
+				}
+				catch (...)
+				{
+					failure = std::current_exception();
+				}
+
+				lock.lock();
+				m_active--;
+
+				auto& target = job.group ? job.group->m_failure : m_failure;
+				if (failure && !target)
+					target = failure;
+
+				if (job.group)
+					job.group->m_pending--;
+
+				// Group waits share the condition with the idle waits.
+				if (job.group || (m_jobs.empty() && m_active == 0))
+					m_idle.notify_all();
+			}
+
+			void work()
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				while (true)
+				{
+					m_jobAvailable.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+					if (m_jobs.empty())
+						return;
+
+					auto job = std::move(m_jobs.front());
+					m_jobs.pop_front();
+					run(lock, job);
+				}
+			}
+		};
+	}
+}
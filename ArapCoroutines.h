@@ -0,0 +1,360 @@
+#pragma once
+
+// Requires C++20.
+
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <sys/epoll.h>
+
+#include "ArapTimers.h"
+#include "ArapUtils.h"
+
+namespace arap
+{
+	namespace coroutines
+	{
+		class Scheduler;
+
+		using Deadline = std::chrono::steady_clock::time_point;
+
+		// Coroutine run by the Scheduler, e.g. one device session. The scheduler takes the
+		// ownership on spawn(), the frame is destroyed when the coroutine returns.
+		class Task
+		{
+		public:
+			struct promise_type
+			{
+				Scheduler* scheduler = nullptr;
+				std::exception_ptr exception;
+
+				Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+				std::suspend_always initial_suspend() noexcept { return {}; }
+
+				struct FinalAwaiter
+				{
+					bool await_ready() noexcept { return false; }
+					void await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+					void await_resume() noexcept {}
+				};
+
+				FinalAwaiter final_suspend() noexcept { return {}; }
+				void return_void() {}
+				void unhandled_exception() { exception = std::current_exception(); }
+			};
+
+			Task(Task&& other) : m_handle(std::exchange(other.m_handle, nullptr))
+			{}
+
+			Task(const Task&) = delete;
+			Task& operator=(const Task&) = delete;
+
+			~Task()
+			{
+				if (m_handle)
+					m_handle.destroy();
+			}
+		private:
+			friend class Scheduler;
+
+			explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle)
+			{}
+
+			std::coroutine_handle<promise_type> m_handle;
+		};
+
+		// Single-threaded scheduler driven by a millisecond TimerWheel and epoll readiness.
+		// An exception escaping a task ends run() with that exception.
+		class Scheduler
+		{
+		public:
+			Scheduler() : m_failure(nullptr)
+			{
+				m_epollDescriptor = epoll_create1(EPOLL_CLOEXEC);
+				if (m_epollDescriptor < 0)
+					throw std::runtime_error("epoll_create1() failed - " + Tools::getErrnoDescription());
+			}
+
+			void spawn(Task task)
+			{
+				auto handle = std::exchange(task.m_handle, nullptr);
+				handle.promise().scheduler = this;
+
+				m_tasks.insert(handle.address());
+				m_ready.push_back(handle);
+			}
+
+			// Returns when every spawned task has finished.
+			void run()
+			{
+				auto previous = std::exchange(currentPointer(), this);
+
+				try
+				{
+					loop();
+				}
+				catch (...)
+				{
+					currentPointer() = previous;
+					throw;
+				}
+
+				currentPointer() = previous;
+			}
+
+			size_t size() const { return m_tasks.size(); }
+
+			// The scheduler running on this thread.
+			static Scheduler& current()
+			{
+				if (currentPointer() == nullptr)
+					throw std::runtime_error("No coroutine scheduler running on this thread.");
+
+				return *currentPointer();
+			}
+
+			void resumeAfter(std::chrono::nanoseconds timeout, std::coroutine_handle<> handle)
+			{
+				addTimer(Clock::monotonic() + timeout.count(), [this, handle]() { m_ready.push_back(handle); });
+			}
+
+			// Resumes the coroutine when the descriptor turns readable or the deadline passes,
+			// the outcome is written to readable before that.
+			void resumeOnReadable(int fileDescriptor, Deadline deadline, std::coroutine_handle<> handle, bool& readable)
+			{
+				if (m_waiters.count(fileDescriptor) > 0)
+					throw std::runtime_error("Descriptor " + std::to_string(fileDescriptor) + " is already awaited by another task.");
+
+				struct epoll_event event = {};
+				event.events = EPOLLIN | EPOLLONESHOT;
+				event.data.fd = fileDescriptor;
+
+				// Descriptors stay registered between the waits, re-armed through the one-shot flag.
+				if (epoll_ctl(m_epollDescriptor, EPOLL_CTL_MOD, fileDescriptor, &event) != 0)
+				{
+					if (errno != ENOENT || epoll_ctl(m_epollDescriptor, EPOLL_CTL_ADD, fileDescriptor, &event) != 0)
+						throw std::runtime_error("epoll_ctl() failed for descriptor " + std::to_string(fileDescriptor) + " - " + Tools::getErrnoDescription());
+				}
+
+				readable = false;
+				auto timeout = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now());
+				auto timerId = addTimer(Clock::monotonic() + timeout.count(), [this, fileDescriptor]()
+					{
+						auto waiter = m_waiters.find(fileDescriptor);
+						m_ready.push_back(waiter->second.handle);
+						m_waiters.erase(waiter);
+					});
+
+				m_waiters[fileDescriptor] = Waiter{handle, timerId, &readable};
+			}
+
+			Scheduler(const Scheduler&) = delete;
+			Scheduler& operator=(const Scheduler&) = delete;
+
+			// Tasks still suspended are destroyed.
+			~Scheduler()
+			{
+				for (auto address : m_tasks)
+					std::coroutine_handle<>::from_address(address).destroy();
+
+				close(m_epollDescriptor);
+			}
+		private:
+			friend struct Task::promise_type::FinalAwaiter;
+
+			static const int64_t nanosecondsPerTick = 1000000;
+
+			using Wheel = BasicTimerWheel<clocks::Monotonic, nanosecondsPerTick>;
+
+			struct Waiter
+			{
+				std::coroutine_handle<> handle;
+				Wheel::Id timerId;
+				bool* readable;
+			};
+
+			static const int maxEvents = 256;
+
+			Wheel m_wheel;
+			std::unordered_set<void*> m_tasks;
+			std::vector<std::coroutine_handle<>> m_ready;
+			std::unordered_map<int, Waiter> m_waiters;
+			std::exception_ptr m_failure;
+			int m_epollDescriptor;
+
+			static Scheduler*& currentPointer()
+			{
+				thread_local Scheduler* scheduler = nullptr;
+				return scheduler;
+			}
+
+			// The wheel counts from its last expire(), which is behind by the time the tasks have run since.
+			// Brought up to date first, and the deadline rounded up to a tick, as in TimerService.
+			Wheel::Id addTimer(int64_t deadline, Wheel::Callback callback)
+			{
+				auto now = Clock::monotonic() / nanosecondsPerTick;
+				m_wheel.expire(static_cast<time_t>(now));
+
+				auto remaining = (deadline + nanosecondsPerTick - 1) / nanosecondsPerTick - now;
+				return m_wheel.addTicks(remaining > 0 ? remaining : 0, std::move(callback));
+			}
+
+			void finished(std::coroutine_handle<Task::promise_type> handle, std::exception_ptr exception)
+			{
+				m_tasks.erase(handle.address());
+
+				if (exception && !m_failure)
+					m_failure = exception;
+			}
+
+			void loop()
+			{
+				std::vector<std::coroutine_handle<>> resuming;
+				struct epoll_event events[maxEvents];
+
+				while (!m_tasks.empty())
+				{
+					m_wheel.expire();
+
+					resuming.swap(m_ready);
+					for (size_t i = 0; i < resuming.size(); i++)
+					{
+						resuming[i].resume();
+
+						if (m_failure)
+						{
+							// The rest stays ready for the next run().
+							m_ready.insert(m_ready.end(), resuming.begin() + i + 1, resuming.end());
+							resuming.clear();
+							std::rethrow_exception(std::exchange(m_failure, nullptr));
+						}
+					}
+					resuming.clear();
+
+					if (m_tasks.empty())
+						break;
+
+					if (!m_ready.empty())
+						continue;
+
+					if (m_wheel.empty() && m_waiters.empty())
+						throw std::runtime_error("Every coroutine task is suspended with nothing to wake it up.");
+
+					auto timeout = m_wheel.nextTimeoutMilliseconds();
+					if (timeout > std::numeric_limits<int>::max())
+						timeout = std::numeric_limits<int>::max();
+
+					auto eventCount = epoll_wait(m_epollDescriptor, events, maxEvents, static_cast<int>(timeout));
+					if (eventCount < 0)
+					{
+						if (errno == EINTR)
+							continue;
+
+						throw std::runtime_error("epoll_wait() failed - " + Tools::getErrnoDescription());
+					}
+
+					for (int i = 0; i < eventCount; i++)
+					{
+						auto waiter = m_waiters.find(events[i].data.fd);
+						if (waiter == m_waiters.end())
+							continue;
+
+						m_wheel.cancel(waiter->second.timerId);
+						*waiter->second.readable = true;
+						m_ready.push_back(waiter->second.handle);
+						m_waiters.erase(waiter);
+					}
+				}
+			}
+		};
+
+		inline void Task::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+		{
+			auto scheduler = handle.promise().scheduler;
+			if (scheduler != nullptr)
+				scheduler->finished(handle, handle.promise().exception);
+
+			handle.destroy();
+		}
+
+		class SleepAwaiter
+		{
+		public:
+			explicit SleepAwaiter(std::chrono::nanoseconds timeout) : m_timeout(timeout)
+			{}
+
+			bool await_ready() const noexcept { return m_timeout.count() <= 0; }
+			void await_suspend(std::coroutine_handle<> handle) { Scheduler::current().resumeAfter(m_timeout, handle); }
+			void await_resume() const noexcept {}
+		private:
+			std::chrono::nanoseconds m_timeout;
+		};
+
+		class ReadableAwaiter
+		{
+		public:
+			ReadableAwaiter(int fileDescriptor, Deadline deadline) : m_fileDescriptor(fileDescriptor), m_deadline(deadline), m_readable(false)
+			{}
+
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle) { Scheduler::current().resumeOnReadable(m_fileDescriptor, m_deadline, handle, m_readable); }
+			bool await_resume() const noexcept { return m_readable; }
+		private:
+			int m_fileDescriptor;
+			Deadline m_deadline;
+			bool m_readable;
+		};
+
+		class ReceiveAwaiter
+		{
+		public:
+			ReceiveAwaiter(network::UdpListener& listener, Deadline deadline) : m_listener(listener), m_readable(listener.getFileDescriptor(), deadline)
+			{}
+
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle) { m_readable.await_suspend(handle); }
+
+			std::optional<std::vector<uint8_t>> await_resume()
+			{
+				if (!m_readable.await_resume())
+					return std::nullopt;
+
+				return m_listener.getData();
+			}
+		private:
+			network::UdpListener& m_listener;
+			ReadableAwaiter m_readable;
+		};
+
+		// co_await sleepFor(std::chrono::milliseconds(250));
+		template <typename Rep, typename Period>
+		inline SleepAwaiter sleepFor(std::chrono::duration<Rep, Period> timeout)
+		{
+			return SleepAwaiter(std::chrono::duration_cast<std::chrono::nanoseconds>(timeout));
+		}
+
+		// bool ready = co_await readable(fd, deadline); - false when the deadline passed first.
+		inline ReadableAwaiter readable(int fileDescriptor, Deadline deadline)
+		{
+			return ReadableAwaiter(fileDescriptor, deadline);
+		}
+
+		// auto packet = co_await receive(listener, deadline); - empty when nothing arrived before the
+		// deadline, getSender() of the listener tells where the packet came from.
+		inline ReceiveAwaiter receive(network::UdpListener& listener, Deadline deadline)
+		{
+			return ReceiveAwaiter(listener, deadline);
+		}
+	}
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace arap
+{
+	// Non-cryptographic 64 bit hash of the wyhash family (final version 4), for hash tables and
+	// fingerprints, not for anything an attacker controls. Reads the bytes in the native order, so the
+	// values differ between little and big endian machines. Keys of a size known at compilation, like
+	// EUI-64 addresses, take a path without any length branches.
+	class Hash
+	{
+	public:
+		static uint64_t bytes(const void* data, size_t size, uint64_t seed = 0)
+		{
+			auto position = static_cast<const uint8_t*>(data);
+			seed ^= mix(seed ^ secret0, secret1);
+
+			uint64_t a;
+			uint64_t b;
+			if (size <= 16)
+			{
+				if (size >= 4)
+				{
+					a = (read4(position) << 32) | read4(position + ((size >> 3) << 2));
+					b = (read4(position + size - 4) << 32) | read4(position + size - 4 - ((size >> 3) << 2));
+				}
+				else if (size > 0)
+				{
+					a = read3(position, size);
+					b = 0;
+				}
+				else
+				{
+					a = b = 0;
+				}
+			}
+			else
+			{
+				auto left = size;
+				if (left > 48)
+				{
+					auto seed1 = seed;
+					auto seed2 = seed;
+					do
+					{
+						seed = mix(read8(position) ^ secret1, read8(position + 8) ^ seed);
+						seed1 = mix(read8(position + 16) ^ secret2, read8(position + 24) ^ seed1);
+						seed2 = mix(read8(position + 32) ^ secret3, read8(position + 40) ^ seed2);
+						position += 48;
+						left -= 48;
+					}
+					while (left > 48);
+
+					seed ^= seed1 ^ seed2;
+				}
+
+				while (left > 16)
+				{
+					seed = mix(read8(position) ^ secret1, read8(position + 8) ^ seed);
+					position += 16;
+					left -= 16;
+				}
+
+				a = read8(position + left - 16);
+				b = read8(position + left - 8);
+			}
+
+			return finish(a, b, seed, size);
+		}
+
+		static uint64_t bytes(std::string_view text, uint64_t seed = 0) { return bytes(text.data(), text.size(), seed); }
+		static uint64_t bytes(const std::vector<uint8_t>& data, uint64_t seed = 0) { return bytes(data.data(), data.size(), seed); }
+
+		// Same value as bytes() over the same Size bytes.
+		template <size_t Size>
+		static uint64_t fixed(const void* data, uint64_t seed = 0)
+		{
+			static_assert(Size == 8 || Size == 16, "Fixed size hashing is for 8 and 16 byte keys.");
+
+			auto position = static_cast<const uint8_t*>(data);
+			seed ^= mix(seed ^ secret0, secret1);
+
+			uint64_t a;
+			uint64_t b;
+			if constexpr (Size == 8)
+			{
+				a = (read4(position) << 32) | read4(position + 4);
+				b = (read4(position + 4) << 32) | read4(position);
+			}
+			else
+			{
+				a = (read4(position) << 32) | read4(position + 8);
+				b = (read4(position + 12) << 32) | read4(position + 4);
+			}
+
+			return finish(a, b, seed, Size);
+		}
+
+		template <size_t Size>
+		static uint64_t fixed(const std::array<uint8_t, Size>& key, uint64_t seed = 0) { return fixed<Size>(key.data(), seed); }
+
+		// The 8 bytes of the integer in memory.
+		static uint64_t fixed(uint64_t key, uint64_t seed = 0) { return fixed<8>(&key, seed); }
+	private:
+		static const uint64_t secret0 = 0x2d358dccaa6c78a5ull;
+		static const uint64_t secret1 = 0x8bb84b93962eacc9ull;
+		static const uint64_t secret2 = 0x4b33a62ed433d4a3ull;
+		static const uint64_t secret3 = 0x4d5a2da51de1aa47ull;
+
+		// Low and high halves of the 128 bit product folded together.
+		static uint64_t mix(uint64_t a, uint64_t b)
+		{
+			auto product = static_cast<unsigned __int128>(a) * b;
+			return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+		}
+
+		static uint64_t finish(uint64_t a, uint64_t b, uint64_t seed, size_t size)
+		{
+			auto product = static_cast<unsigned __int128>(a ^ secret1) * (b ^ seed);
+			return mix(static_cast<uint64_t>(product) ^ secret0 ^ size, static_cast<uint64_t>(product >> 64) ^ secret1);
+		}
+
+		static uint64_t read8(const uint8_t* position) { uint64_t value; std::memcpy(&value, position, 8); return value; }
+		static uint64_t read4(const uint8_t* position) { uint32_t value; std::memcpy(&value, position, 4); return value; }
+
+		static uint64_t read3(const uint8_t* position, size_t size)
+		{
+			return (static_cast<uint64_t>(position[0]) << 16) | (static_cast<uint64_t>(position[size >> 1]) << 8) | position[size - 1];
+		}
+
+		Hash(){}
+		~Hash(){}
+	};
+
+	// For the unordered containers, transparent so a std::string_view finds a std::string key:
+	//   std::unordered_map<std::string, int, arap::Hasher, std::equal_to<>> map;
+	struct Hasher
+	{
+		using is_transparent = void;
+
+		size_t operator()(std::string_view text) const { return Hash::bytes(text); }
+		size_t operator()(const std::string& text) const { return Hash::bytes(text); }
+		size_t operator()(const char* text) const { return Hash::bytes(std::string_view(text)); }
+		size_t operator()(const std::vector<uint8_t>& data) const { return Hash::bytes(data); }
+		size_t operator()(uint64_t key) const { return Hash::fixed(key); }
+
+		template <size_t Size>
+		size_t operator()(const std::array<uint8_t, Size>& key) const
+		{
+			if constexpr (Size == 8 || Size == 16)
+				return Hash::fixed(key);
+			else
+				return Hash::bytes(key.data(), Size);
+		}
+	};
+}
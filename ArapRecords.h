@@ -0,0 +1,246 @@
+#pragma once
+
+// Requires C++17.
+
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ArapUtils.h"
+
+namespace arap
+{
+	namespace records
+	{
+		// Field type for hh:mm:ss, seconds since midnight.
+		struct Time24h
+		{
+			uint32_t seconds;
+
+			// Rules of Tools::getTime24h() - three fields, zero written as "00", hours up to 23.
+			static bool parse(std::string_view text, Time24h& time)
+			{
+				const uint32_t limits[] = {23, 59, 59};
+				auto position = text.data();
+				auto end = position + text.size();
+
+				uint32_t seconds = 0;
+				for (int i = 0; i < 3; i++)
+				{
+					uint32_t value;
+					auto result = std::from_chars(position, end, value);
+					if (result.ec != std::errc() || value > limits[i] || (value == 0 && result.ptr - position != 2))
+						return false;
+
+					seconds = seconds * 60 + value;
+					position = result.ptr;
+					if (i < 2)
+					{
+						if (position == end || *position != ':')
+							return false;
+
+						position++;
+					}
+				}
+
+				if (position != end)
+					return false;
+
+				time.seconds = seconds;
+				return true;
+			}
+		};
+
+		// Delimited line mapped straight into typed fields, the schema given by the template arguments:
+		//   records::Parser<uint32_t, double, std::string_view, records::Time24h> parser;
+		// Integers and floating points go through std::from_chars(), a std::string_view points into the
+		// line itself, so nothing is allocated per line. A field may be quoted - the view excludes the
+		// quotes, a doubled quote inside it is left as is.
+		template <typename... Fields>
+		class Parser
+		{
+		public:
+			using Record = std::tuple<Fields...>;
+
+			Parser(char delimiter = ',', char quote = '"') : m_delimiter(delimiter), m_quote(quote)
+			{}
+
+			// False when the line has a different count of fields or a value does not fit its type.
+			bool parse(std::string_view line, Record& record) const
+			{
+				return parseFields(line, record, std::index_sequence_for<Fields...>()) == sizeof...(Fields);
+			}
+
+			Record parse(std::string_view line) const
+			{
+				Record record;
+				auto parsed = parseFields(line, record, std::index_sequence_for<Fields...>());
+				if (parsed != sizeof...(Fields))
+					throw std::runtime_error("Field " + std::to_string(parsed) + " of record \"" + std::string(line) + "\" does not match the schema.");
+
+				return record;
+			}
+		private:
+			char m_delimiter;
+			char m_quote;
+
+			// Count of the fields parsed before the first failure.
+			template <size_t... Indexes>
+			size_t parseFields(std::string_view line, Record& record, std::index_sequence<Indexes...>) const
+			{
+				auto position = line.data();
+				auto end = position + line.size();
+				size_t parsed = 0;
+
+				((nextField(position, end, Indexes + 1 == sizeof...(Fields), std::get<Indexes>(record)) && ++parsed) && ...);
+				return parsed;
+			}
+
+			// Moves the position past the delimiter following the field, the last field has to end the line.
+			template <typename Value>
+			bool nextField(const char*& position, const char* end, bool last, Value& value) const
+			{
+				std::string_view field;
+				if (position != end && *position == m_quote)
+				{
+					auto begin = ++position;
+					while (true)
+					{
+						position = strings::Scanner::find(position, end, m_quote);
+						if (position == end)
+							return false;
+
+						if (position + 1 == end || position[1] != m_quote)
+							break;
+
+						position += 2;
+					}
+
+					field = std::string_view(begin, position - begin);
+					position++;
+				}
+				else
+				{
+					auto begin = position;
+					position = strings::Scanner::find(position, end, m_delimiter);
+					field = std::string_view(begin, position - begin);
+				}
+
+				if (last)
+				{
+					if (position != end)
+						return false;
+				}
+				else
+				{
+					if (position == end || *position != m_delimiter)
+						return false;
+
+					position++;
+				}
+
+				return convert(field, value);
+			}
+
+			template <typename Value>
+			static bool convert(std::string_view field, Value& value)
+			{
+				if constexpr (std::is_same_v<Value, std::string_view>)
+				{
+					value = field;
+					return true;
+				}
+				else if constexpr (std::is_same_v<Value, Time24h>)
+				{
+					return Time24h::parse(field, value);
+				}
+				else
+				{
+					static_assert((std::is_integral_v<Value> && !std::is_same_v<Value, bool>) || std::is_floating_point_v<Value>,
+						"Record fields are integers, floating points, std::string_view or Time24h.");
+
+					auto end = field.data() + field.size();
+					auto result = std::from_chars(field.data(), end, value);
+					return result.ec == std::errc() && result.ptr == end;
+				}
+			}
+		};
+
+		// Delimited file loaded into one vector per field (structure of arrays), the chunks of the mapped
+		// file are parsed in parallel on the pool. Rows keep the order of the file, lines not matching the
+		// schema are skipped and counted. Columns of std::string_view point into the mapping, so they
+		// stay valid for the lifetime of the table.
+		template <typename... Fields>
+		class ColumnarTable
+		{
+		public:
+			static_assert(sizeof...(Fields) > 0, "ColumnarTable needs at least one field.");
+
+			using Columns = std::tuple<std::vector<Fields>...>;
+
+			ColumnarTable(const std::string& filePath, concurrent::ThreadPool& pool, const Parser<Fields...>& parser = Parser<Fields...>())
+				: m_file(filePath), m_rejectedLines(0)
+			{
+				auto loaded = strings::ParallelLines::mapReduce(pool, m_file.data(), Chunk(),
+					[&parser](Chunk& chunk, std::string_view line)
+					{
+						if (line.empty())
+							return;
+
+						typename Parser<Fields...>::Record record;
+						if (parser.parse(line, record))
+							chunk.append(record, std::index_sequence_for<Fields...>());
+						else
+							chunk.rejectedLines++;
+					},
+					[](Chunk& total, Chunk&& chunk)
+					{
+						total.append(std::move(chunk), std::index_sequence_for<Fields...>());
+					});
+
+				m_columns = std::move(loaded.columns);
+				m_rejectedLines = loaded.rejectedLines;
+			}
+
+			template <size_t Index>
+			const std::vector<std::tuple_element_t<Index, std::tuple<Fields...>>>& column() const { return std::get<Index>(m_columns); }
+
+			const Columns& getColumns() const { return m_columns; }
+			size_t size() const { return std::get<0>(m_columns).size(); }
+			size_t getRejectedLines() const { return m_rejectedLines; }
+
+			ColumnarTable(const ColumnarTable&) = delete;
+			ColumnarTable& operator=(const ColumnarTable&) = delete;
+		private:
+			struct Chunk
+			{
+				Columns columns;
+				size_t rejectedLines = 0;
+
+				template <size_t... Indexes>
+				void append(const typename Parser<Fields...>::Record& record, std::index_sequence<Indexes...>)
+				{
+					(std::get<Indexes>(columns).push_back(std::get<Indexes>(record)), ...);
+				}
+
+				template <size_t... Indexes>
+				void append(Chunk&& chunk, std::index_sequence<Indexes...>)
+				{
+					(std::get<Indexes>(columns).insert(std::get<Indexes>(columns).end(), std::get<Indexes>(chunk.columns).begin(), std::get<Indexes>(chunk.columns).end()), ...);
+					rejectedLines += chunk.rejectedLines;
+				}
+			};
+
+			strings::MappedLines m_file;
+			Columns m_columns;
+			size_t m_rejectedLines;
+		};
+	}
+}
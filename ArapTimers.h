@@ -1,9 +1,35 @@
 #pragma once
 
+#include <atomic>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <ctime>
+#include <functional>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "ArapClock.h"
+#include "ArapConcurrent.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ARAP_TIMERS_X86
+#include <immintrin.h>
+#endif
+
 namespace arap
 {
 	class Timer
@@ -13,7 +39,13 @@ namespace arap
 		~Timer() = default;
 		
 		virtual void set(uint32_t seconds) = 0;
-		virtual void set(std::vector<uint32_t> intervals) = delete;
+		// Multi-interval schedule, implemented by ScheduleTimer.
+		virtual void set(std::vector<uint32_t> intervals)
+		{
+			(void)intervals;
+			throw std::runtime_error("Interval schedules are not supported by this timer.");
+		}
+
 		virtual void reset() = 0;
 
 		virtual void pause() = 0;
@@ -25,13 +57,14 @@ namespace arap
 		virtual uint32_t nextTimeout() = 0;
 	};
 
-	class SimpleTimer final : Timer
+	template <typename Clock = clocks::System>
+	class BasicSimpleTimer final : Timer
 	{
 	public:
-		SimpleTimer() : m_timeoutDuration(0), m_timeoutEpoch(0), m_pauseContinuum(0)
+		BasicSimpleTimer() : m_timeoutDuration(0), m_timeoutEpoch(0), m_pauseContinuum(0)
 		{}
 		
-		SimpleTimer(uint32_t timeout) : SimpleTimer() 
+		BasicSimpleTimer(uint32_t timeout) : BasicSimpleTimer() 
 		{
 			set(timeout);
 		}
@@ -58,7 +91,7 @@ namespace arap
 		void restart()
 		{
 			if (m_timeoutDuration > 0)
-				m_timeoutEpoch = std::time(nullptr) + m_timeoutDuration;
+				m_timeoutEpoch = Clock::seconds() + m_timeoutDuration;
 			
 			m_pauseContinuum = 0;
 		}
@@ -87,7 +120,7 @@ namespace arap
 			if (m_timeoutEpoch == 0)
 				return false;
 			
-			return m_timeoutEpoch <= std::time(nullptr);
+			return m_timeoutEpoch <= Clock::seconds();
 		}
 
 		uint32_t elapsed() override
@@ -101,7 +134,7 @@ namespace arap
 			if (m_timeoutEpoch == 0)
 				return 0;
 
-			return std::time(nullptr) - (m_timeoutEpoch - m_timeoutDuration);
+			return Clock::seconds() - (m_timeoutEpoch - m_timeoutDuration);
 		}
 
 		uint32_t nextTimeout() override
@@ -113,13 +146,1445 @@ namespace arap
 		}
 
 		// Default keyword does not work like I think it is supposed to, currently disabled.
-		//SimpleTimer(const SimpleTimer& other) { return other; }
-		//SimpleTimer(SimpleTimer&& other) = default;
+		//BasicSimpleTimer(const BasicSimpleTimer& other) { return other; }
+		//BasicSimpleTimer(BasicSimpleTimer&& other) = default;
 
-		~SimpleTimer(){}
+		~BasicSimpleTimer(){}
 	private:
 		uint32_t m_timeoutDuration;
 		time_t m_timeoutEpoch;
 		uint32_t m_pauseContinuum;
 	};
+
+	using SimpleTimer = BasicSimpleTimer<>;
+
+	// Sub-second timer, on CLOCK_MONOTONIC by default so the wall clock adjustments do not affect it.
+	template <typename Clock = clocks::Monotonic>
+	class BasicMonotonicTimer final : Timer
+	{
+	public:
+		BasicMonotonicTimer() : m_timeoutDuration(0), m_timeoutEpoch(0), m_pauseContinuum(0), m_paused(false)
+		{}
+
+		BasicMonotonicTimer(uint32_t timeout) : BasicMonotonicTimer()
+		{
+			set(timeout);
+		}
+
+		// Any integral duration converts, e.g. std::chrono::seconds(5) or std::chrono::microseconds(300).
+		BasicMonotonicTimer(std::chrono::nanoseconds timeout) : BasicMonotonicTimer()
+		{
+			set(timeout);
+		}
+
+		void set(uint32_t seconds) override { setNanoseconds(static_cast<int64_t>(seconds) * clocks::nanosecondsPerSecond); }
+		void set(std::chrono::nanoseconds timeout) { setNanoseconds(timeout.count()); }
+
+		// Start counting from the last timeout.
+		void reset() override
+		{
+			if (m_timeoutEpoch == 0)
+				return restart();
+
+			if (m_timeoutDuration > 0)
+				m_timeoutEpoch += m_timeoutDuration;
+
+			m_pauseContinuum = 0;
+			m_paused = false;
+		}
+
+		// Start counting from now.
+		void restart()
+		{
+			if (m_timeoutDuration > 0)
+				m_timeoutEpoch = now() + m_timeoutDuration;
+
+			m_pauseContinuum = 0;
+			m_paused = false;
+		}
+
+		void pause() override
+		{
+			if (m_paused || m_timeoutEpoch == 0 || expired())
+				return;
+
+			m_pauseContinuum = elapsedNanoseconds();
+			m_paused = true;
+		}
+
+		void stop() override
+		{
+			m_timeoutEpoch = m_pauseContinuum = 0;
+			m_paused = false;
+		}
+
+		void run() override
+		{
+			if (!m_paused)
+			{
+				restart();
+				return;
+			}
+
+			assert(m_pauseContinuum < m_timeoutDuration);
+			m_timeoutEpoch = now() + (m_timeoutDuration - m_pauseContinuum);
+			m_pauseContinuum = 0;
+			m_paused = false;
+		}
+
+		bool expired() override
+		{
+			if (m_paused)
+				return false;
+
+			if (m_timeoutEpoch == 0)
+				return false;
+
+			return m_timeoutEpoch <= now();
+		}
+
+		uint32_t elapsed() override { return static_cast<uint32_t>(elapsedNanoseconds() / clocks::nanosecondsPerSecond); }
+
+		// Set and counting, neither stopped nor paused.
+		bool isRunning() const { return m_timeoutEpoch != 0 && !m_paused; }
+
+		int64_t elapsedNanoseconds()
+		{
+			if (expired())
+				return m_timeoutDuration;
+
+			if (m_paused)
+				return m_pauseContinuum;
+
+			if (m_timeoutEpoch == 0)
+				return 0;
+
+			return now() - (m_timeoutEpoch - m_timeoutDuration);
+		}
+
+		// Rounded up, waiting for the returned amount never wakes up before the expiration.
+		uint32_t nextTimeout() override
+		{
+			return static_cast<uint32_t>((nextTimeoutNanoseconds() + clocks::nanosecondsPerSecond - 1) / clocks::nanosecondsPerSecond);
+		}
+
+		int64_t nextTimeoutMilliseconds()
+		{
+			return (nextTimeoutNanoseconds() + nanosecondsPerMillisecond - 1) / nanosecondsPerMillisecond;
+		}
+
+		int64_t nextTimeoutNanoseconds()
+		{
+			if (expired())
+				return 0;
+
+			return m_timeoutDuration - elapsedNanoseconds();
+		}
+
+		~BasicMonotonicTimer(){}
+	private:
+		static const int64_t nanosecondsPerMillisecond = 1000000;
+
+		int64_t m_timeoutDuration;
+		int64_t m_timeoutEpoch;
+		int64_t m_pauseContinuum;
+		bool m_paused;
+
+		void setNanoseconds(int64_t duration)
+		{
+			m_timeoutDuration = duration;
+			restart();
+		}
+
+		static int64_t now() { return Clock::nanoseconds(); }
+	};
+
+	using MonotonicTimer = BasicMonotonicTimer<>;
+
+	// Timer going through a schedule of intervals, e.g. retries with exponential backoff.
+	// Optional jitter shortens every interval by a random part of up to the given percentage,
+	// so that nodes restarted together do not retry in sync. Checks are O(1) and nothing
+	// gets allocated after set().
+	template <typename Clock = clocks::Monotonic>
+	class BasicScheduleTimer final : Timer
+	{
+	public:
+		BasicScheduleTimer() : m_step(0), m_timeoutDuration(0), m_timeoutEpoch(0), m_pauseContinuum(0), m_paused(false), m_jitterPercent(0)
+		{
+			std::random_device device;
+			seed((static_cast<uint64_t>(device()) << 32) ^ device() ^ reinterpret_cast<uintptr_t>(this));
+		}
+
+		BasicScheduleTimer(std::vector<uint32_t> intervals, uint32_t jitterPercent = 0) : BasicScheduleTimer()
+		{
+			setJitter(jitterPercent);
+			set(std::move(intervals));
+		}
+
+		void set(uint32_t seconds) override { set(std::vector<uint32_t>{seconds}); }
+
+		// Intervals in seconds, the last one repeats once the schedule is through.
+		void set(std::vector<uint32_t> intervals) override
+		{
+			if (intervals.empty())
+				throw std::runtime_error("Timer schedule needs at least one interval.");
+
+			m_intervals = std::move(intervals);
+			rewind();
+		}
+
+		// Applies from the next interval on.
+		void setJitter(uint32_t percent) { m_jitterPercent = percent > 100 ? 100 : percent; }
+		void seed(uint64_t value) { m_randomState = value != 0 ? value : 0x9E3779B97F4A7C15ull; }
+
+		// Back to the first interval, counting from now.
+		void rewind()
+		{
+			m_step = 0;
+			startStep(now());
+		}
+
+		// Next interval counting from the last timeout.
+		void reset() override
+		{
+			if (m_timeoutEpoch == 0)
+				return restart();
+
+			advance();
+			startStep(m_timeoutEpoch);
+		}
+
+		// Next interval counting from now.
+		void restart()
+		{
+			if (m_intervals.empty())
+				return;
+
+			advance();
+			startStep(now());
+		}
+
+		void pause() override
+		{
+			if (m_paused || m_timeoutEpoch == 0 || expired())
+				return;
+
+			m_pauseContinuum = elapsedNanoseconds();
+			m_paused = true;
+		}
+
+		void stop() override
+		{
+			m_timeoutEpoch = m_pauseContinuum = 0;
+			m_paused = false;
+		}
+
+		void run() override
+		{
+			if (!m_paused)
+			{
+				if (m_timeoutEpoch == 0)
+					startStep(now());
+
+				return;
+			}
+
+			m_timeoutEpoch = now() + (m_timeoutDuration - m_pauseContinuum);
+			m_pauseContinuum = 0;
+			m_paused = false;
+		}
+
+		bool expired() override
+		{
+			if (m_paused || m_timeoutEpoch == 0)
+				return false;
+
+			return m_timeoutEpoch <= now();
+		}
+
+		uint32_t elapsed() override { return static_cast<uint32_t>(elapsedNanoseconds() / clocks::nanosecondsPerSecond); }
+
+		int64_t elapsedNanoseconds()
+		{
+			if (expired())
+				return m_timeoutDuration;
+
+			if (m_paused)
+				return m_pauseContinuum;
+
+			if (m_timeoutEpoch == 0)
+				return 0;
+
+			return now() - (m_timeoutEpoch - m_timeoutDuration);
+		}
+
+		// Rounded up.
+		uint32_t nextTimeout() override
+		{
+			return static_cast<uint32_t>((nextTimeoutNanoseconds() + clocks::nanosecondsPerSecond - 1) / clocks::nanosecondsPerSecond);
+		}
+
+		int64_t nextTimeoutNanoseconds()
+		{
+			if (expired())
+				return 0;
+
+			return m_timeoutDuration - elapsedNanoseconds();
+		}
+
+		// Index of the interval currently counted and its length after the jitter.
+		size_t step() const { return m_step; }
+		int64_t intervalNanoseconds() const { return m_timeoutDuration; }
+
+		// Doubling intervals from initial up to maximum, count entries in total.
+		static std::vector<uint32_t> exponentialBackoff(uint32_t initial, uint32_t maximum, uint32_t count)
+		{
+			std::vector<uint32_t> intervals;
+			intervals.reserve(count);
+
+			uint64_t interval = initial;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				intervals.push_back(static_cast<uint32_t>(interval < maximum ? interval : maximum));
+				interval *= 2;
+			}
+
+			return intervals;
+		}
+
+		~BasicScheduleTimer(){}
+	private:
+		std::vector<uint32_t> m_intervals;
+		size_t m_step;
+		int64_t m_timeoutDuration;
+		int64_t m_timeoutEpoch;
+		int64_t m_pauseContinuum;
+		bool m_paused;
+		uint32_t m_jitterPercent;
+		uint64_t m_randomState;
+
+		static int64_t now() { return Clock::nanoseconds(); }
+
+		void advance()
+		{
+			if (m_step + 1 < m_intervals.size())
+				m_step++;
+		}
+
+		void startStep(int64_t from)
+		{
+			m_timeoutDuration = static_cast<int64_t>(m_intervals[m_step]) * clocks::nanosecondsPerSecond;
+
+			// Split so that multiplying by the percentage cannot overflow, intervals go up to 2^32 seconds.
+			if (m_jitterPercent > 0 && m_timeoutDuration > 0)
+			{
+				auto duration = static_cast<uint64_t>(m_timeoutDuration);
+				auto range = duration / 100 * m_jitterPercent + duration % 100 * m_jitterPercent / 100;
+				m_timeoutDuration -= static_cast<int64_t>(nextRandom() % (range + 1));
+			}
+
+			m_timeoutEpoch = m_timeoutDuration > 0 ? from + m_timeoutDuration : 0;
+			m_pauseContinuum = 0;
+			m_paused = false;
+		}
+
+		// xorshift64*, all of the 64 bits are used, plenty for spreading out the retries.
+		uint64_t nextRandom()
+		{
+			m_randomState ^= m_randomState >> 12;
+			m_randomState ^= m_randomState << 25;
+			m_randomState ^= m_randomState >> 27;
+
+			return m_randomState * 0x2545F4914F6CDD1Dull;
+		}
+	};
+
+	using ScheduleTimer = BasicScheduleTimer<>;
+
+	// MonotonicTimer backed by a timerfd - the descriptor turns readable on expiration,
+	// so an event loop can poll()/epoll() it together with the sockets and serial ports.
+	class DescriptorTimer final : Timer
+	{
+	public:
+		DescriptorTimer()
+		{
+			m_fileDescriptor = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+			if (m_fileDescriptor < 0)
+				throw std::runtime_error(std::string("timerfd_create() failed - ") + std::strerror(errno));
+		}
+
+		DescriptorTimer(uint32_t timeout) : DescriptorTimer()
+		{
+			set(timeout);
+		}
+
+		DescriptorTimer(std::chrono::nanoseconds timeout) : DescriptorTimer()
+		{
+			set(timeout);
+		}
+
+		void set(uint32_t seconds) override { m_timer.set(seconds); arm(); }
+		void set(std::chrono::nanoseconds timeout) { m_timer.set(timeout); arm(); }
+
+		void reset() override { m_timer.reset(); arm(); }
+		void restart() { m_timer.restart(); arm(); }
+
+		void pause() override { m_timer.pause(); arm(); }
+		void stop() override { m_timer.stop(); arm(); }
+		void run() override { m_timer.run(); arm(); }
+
+		bool expired() override { return m_timer.expired(); }
+		uint32_t elapsed() override { return m_timer.elapsed(); }
+		int64_t elapsedNanoseconds() { return m_timer.elapsedNanoseconds(); }
+		uint32_t nextTimeout() override { return m_timer.nextTimeout(); }
+		int64_t nextTimeoutMilliseconds() { return m_timer.nextTimeoutMilliseconds(); }
+		int64_t nextTimeoutNanoseconds() { return m_timer.nextTimeoutNanoseconds(); }
+
+		int getFileDescriptor() const { return m_fileDescriptor; }
+
+		// Clears the readable state after a wake-up, returns the count of expirations read.
+		// The timer itself stays expired until reset(), restart() or set().
+		uint64_t acknowledge()
+		{
+			uint64_t expirations = 0;
+			auto readResult = read(m_fileDescriptor, &expirations, sizeof(expirations));
+
+			if (readResult < 0)
+			{
+				if (errno == EAGAIN || errno == EINTR)
+					return 0;
+
+				throw std::runtime_error(std::string("Reading timerfd failed - ") + std::strerror(errno));
+			}
+
+			return expirations;
+		}
+
+		DescriptorTimer(const DescriptorTimer&) = delete;
+		DescriptorTimer& operator=(const DescriptorTimer&) = delete;
+
+		~DescriptorTimer()
+		{
+			close(m_fileDescriptor);
+		}
+	private:
+		int m_fileDescriptor;
+		MonotonicTimer m_timer;
+
+		// Re-arming also clears the expirations not acknowledged yet.
+		void arm()
+		{
+			struct itimerspec specification = {};
+
+			if (m_timer.isRunning())
+			{
+				auto remaining = m_timer.nextTimeoutNanoseconds();
+				// Already expired, the descriptor has to turn readable right away.
+				if (remaining <= 0)
+					remaining = 1;
+
+				specification.it_value.tv_sec = remaining / 1000000000;
+				specification.it_value.tv_nsec = remaining % 1000000000;
+			}
+
+			if (timerfd_settime(m_fileDescriptor, 0, &specification, nullptr) != 0)
+				throw std::runtime_error(std::string("timerfd_settime() failed - ") + std::strerror(errno));
+		}
+	};
+
+	// Hierarchical timing wheel for large amounts of timers sharing one clock read.
+	// Timeouts are counted from the time of the last expire() call, so an event loop
+	// should call expire() on every iteration. Insert, cancel and expiry are O(1).
+	// The wheel turns in ticks of one second unless a shorter tick is given, the explicit
+	// times taken by the constructor and expire() are in ticks of the clock.
+	template <typename Clock = clocks::System, int64_t tickNanoseconds = clocks::nanosecondsPerSecond>
+	class BasicTimerWheel
+	{
+		static_assert(tickNanoseconds > 0 && clocks::nanosecondsPerSecond % tickNanoseconds == 0, "Tick has to divide a second.");
+	public:
+		using Callback = std::function<void()>;
+		using Id = uint64_t;
+
+		BasicTimerWheel() : BasicTimerWheel(currentTick())
+		{}
+
+		BasicTimerWheel(time_t now) : m_current(now), m_now(now), m_count(0), m_freeNode(invalidNode), m_slackTicks(0), m_occupied()
+		{
+			for (auto& head : m_slots)
+				head = invalidNode;
+		}
+
+		// Slack for the timers added afterwards without a slack of their own. A timer may fire up to
+		// the slack later than asked, the expiry is moved to the tick with the most trailing zero bits
+		// inside the window like Linux timerslack does, so timers of nearby expiries fire together.
+		template <typename Rep, typename Period>
+		void setSlack(std::chrono::duration<Rep, Period> slack)
+		{
+			m_slackTicks = toSlackTicks(slack);
+		}
+
+		Id add(uint32_t seconds, Callback callback)
+		{
+			return addTicks(static_cast<uint64_t>(seconds) * ticksPerSecond, std::move(callback));
+		}
+
+		// Rounded up to whole ticks.
+		template <typename Rep, typename Period>
+		Id add(std::chrono::duration<Rep, Period> timeout, Callback callback)
+		{
+			return addTicks(toTicks(timeout), std::move(callback));
+		}
+
+		// Slack of this timer only, rounded down to whole ticks.
+		template <typename Rep, typename Period, typename SlackRep, typename SlackPeriod>
+		Id add(std::chrono::duration<Rep, Period> timeout, Callback callback, std::chrono::duration<SlackRep, SlackPeriod> slack)
+		{
+			return addTicks(toTicks(timeout), std::move(callback), toSlackTicks(slack));
+		}
+
+		Id addTicks(uint64_t ticks, Callback callback)
+		{
+			return addTicks(ticks, std::move(callback), m_slackTicks);
+		}
+
+		Id addTicks(uint64_t ticks, Callback callback, uint64_t slackTicks)
+		{
+			auto index = allocateNode();
+			auto& node = m_nodes[index];
+			node.expiry = applySlack(m_now + ticks, slackTicks);
+			node.callback = std::move(callback);
+			place(index);
+			m_count++;
+
+			return (static_cast<Id>(node.generation) << 32) | index;
+		}
+
+		// Returns false when the timer has already fired or was cancelled before.
+		bool cancel(Id id)
+		{
+			auto index = static_cast<uint32_t>(id);
+			if (index >= m_nodes.size())
+				return false;
+
+			auto& node = m_nodes[index];
+			if (node.slot == freeSlot || node.generation != static_cast<uint32_t>(id >> 32))
+				return false;
+
+			unlink(index);
+			releaseNode(index);
+			m_count--;
+
+			return true;
+		}
+
+		size_t expire() { return expire(currentTick()); }
+
+		// Fires every timer due at or before now, returns the count of fired callbacks.
+		size_t expire(time_t now)
+		{
+			size_t fired = firePending();
+			auto target = static_cast<uint64_t>(now);
+
+			while (m_current <= target)
+			{
+				if (m_count == 0)
+				{
+					m_current = target + 1;
+					break;
+				}
+
+				auto tick = m_current;
+				if ((tick & slotMask) == 0)
+					cascade(tick);
+
+				if (m_slots[tick & slotMask] == invalidNode)
+				{
+					m_current = nextInterestingTick(tick, target);
+					continue;
+				}
+
+				m_current = tick + 1;
+				m_now = tick;
+				moveSlot(tick & slotMask, pendingSlot);
+				fired += firePending();
+			}
+
+			if (target > m_now)
+				m_now = target;
+
+			return fired;
+		}
+
+		// Seconds until the earliest timer fires rounded up, maximum value when there is nothing scheduled.
+		uint32_t nextTimeout() const
+		{
+			auto ticks = nextTimeoutTicks();
+			if (ticks == std::numeric_limits<uint64_t>::max())
+				return std::numeric_limits<uint32_t>::max();
+
+			auto seconds = (ticks + ticksPerSecond - 1) / ticksPerSecond;
+			if (seconds > std::numeric_limits<uint32_t>::max())
+				return std::numeric_limits<uint32_t>::max();
+
+			return static_cast<uint32_t>(seconds);
+		}
+
+		// Rounded up, -1 when there is nothing scheduled - ready to be passed to poll().
+		int64_t nextTimeoutMilliseconds() const
+		{
+			auto ticks = nextTimeoutTicks();
+			if (ticks == std::numeric_limits<uint64_t>::max())
+				return -1;
+
+			const uint64_t nanosecondsPerMillisecond = 1000000;
+			if (ticks > static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) / tickNanoseconds)
+				return std::numeric_limits<int64_t>::max() / nanosecondsPerMillisecond;
+
+			return static_cast<int64_t>((ticks * tickNanoseconds + nanosecondsPerMillisecond - 1) / nanosecondsPerMillisecond);
+		}
+
+		// Maximum value when there is nothing scheduled.
+		uint64_t nextTimeoutTicks() const
+		{
+			if (m_count == 0)
+				return std::numeric_limits<uint64_t>::max();
+
+			if (m_slots[pendingSlot] != invalidNode || m_slots[firingSlot] != invalidNode)
+				return 0;
+
+			auto earliest = std::numeric_limits<uint64_t>::max();
+
+			auto levelZero = findOccupied(0, m_current & slotMask);
+			if (levelZero != invalidSlot)
+				earliest = m_current + ((levelZero - m_current) & slotMask);
+
+			for (uint32_t level = 1; level < levels; level++)
+			{
+				auto shift = level * levelBits;
+				auto block = m_current >> shift;
+				// Slot of the current block has already been cascaded unless we stand at its very beginning.
+				auto start = (m_current & ((uint64_t(1) << shift) - 1)) == 0 ? block : block + 1;
+				auto slot = findOccupied(level, start & slotMask);
+				if (slot == invalidSlot)
+					continue;
+
+				for (auto index = m_slots[level * slotsPerLevel + slot]; index != invalidNode; index = m_nodes[index].next)
+				{
+					if (m_nodes[index].expiry < earliest)
+						earliest = m_nodes[index].expiry;
+				}
+			}
+
+			if (earliest <= m_now)
+				return 0;
+
+			return earliest - m_now;
+		}
+
+		size_t size() const { return m_count; }
+		bool empty() const { return m_count == 0; }
+
+		BasicTimerWheel(const BasicTimerWheel&) = delete;
+		BasicTimerWheel& operator=(const BasicTimerWheel&) = delete;
+
+		~BasicTimerWheel(){}
+	private:
+		static const uint64_t ticksPerSecond = clocks::nanosecondsPerSecond / tickNanoseconds;
+		static const uint32_t levelBits = 8;
+		static const uint32_t slotsPerLevel = 1 << levelBits;
+		static const uint64_t slotMask = slotsPerLevel - 1;
+		static const uint32_t levels = 4;
+		static const uint32_t pendingSlot = levels * slotsPerLevel;
+		static const uint32_t firingSlot = pendingSlot + 1;
+		static const uint32_t freeSlot = firingSlot + 1;
+		static const uint32_t invalidNode = std::numeric_limits<uint32_t>::max();
+		static const uint32_t invalidSlot = std::numeric_limits<uint32_t>::max();
+
+		struct Node
+		{
+			uint64_t expiry;
+			Callback callback;
+			uint32_t next;
+			uint32_t previous;
+			uint32_t generation;
+			uint32_t slot;
+		};
+
+		std::vector<Node> m_nodes;
+		// Heads of the intrusive slot lists, the extra ones hold due timers and timers being fired.
+		uint32_t m_slots[levels * slotsPerLevel + 2];
+		// Next tick to be processed.
+		uint64_t m_current;
+		// Time of the last processed tick, base for the new timeouts.
+		uint64_t m_now;
+		size_t m_count;
+		uint32_t m_freeNode;
+		uint64_t m_slackTicks;
+		uint64_t m_occupied[levels][slotsPerLevel / 64];
+
+		template <typename Rep, typename Period>
+		static uint64_t toTicks(std::chrono::duration<Rep, Period> timeout)
+		{
+			auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+			if (nanoseconds < 0)
+				nanoseconds = 0;
+
+			return (static_cast<uint64_t>(nanoseconds) + tickNanoseconds - 1) / tickNanoseconds;
+		}
+
+		template <typename Rep, typename Period>
+		static uint64_t toSlackTicks(std::chrono::duration<Rep, Period> slack)
+		{
+			auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(slack).count();
+			if (nanoseconds < 0)
+				nanoseconds = 0;
+
+			return static_cast<uint64_t>(nanoseconds) / tickNanoseconds;
+		}
+
+		// Latest tick of the window with the highest bit differing from the expiry cleared below it,
+		// the same tick is picked for every expiry sharing that bit prefix.
+		static uint64_t applySlack(uint64_t expiry, uint64_t slackTicks)
+		{
+			if (slackTicks == 0 || expiry > std::numeric_limits<uint64_t>::max() - slackTicks)
+				return expiry;
+
+			auto limit = expiry + slackTicks;
+			auto differing = expiry ^ limit;
+			auto highest = 63 - __builtin_clzll(differing);
+
+			return limit & ~((uint64_t(1) << highest) - 1);
+		}
+
+		uint32_t allocateNode()
+		{
+			if (m_freeNode != invalidNode)
+			{
+				auto index = m_freeNode;
+				m_freeNode = m_nodes[index].next;
+				return index;
+			}
+
+			m_nodes.push_back(Node{0, nullptr, invalidNode, invalidNode, 1, freeSlot});
+			return static_cast<uint32_t>(m_nodes.size() - 1);
+		}
+
+		void releaseNode(uint32_t index)
+		{
+			auto& node = m_nodes[index];
+			node.callback = nullptr;
+			node.slot = freeSlot;
+			node.generation++;
+			node.next = m_freeNode;
+			m_freeNode = index;
+		}
+
+		void place(uint32_t index)
+		{
+			auto expiry = m_nodes[index].expiry;
+			if (expiry <= m_now)
+				return link(index, pendingSlot);
+
+			if (expiry < m_current)
+				expiry = m_current;
+
+			auto delta = expiry - m_current;
+			uint32_t level = 0;
+			while (level < levels - 1 && delta >= (uint64_t(1) << ((level + 1) * levelBits)))
+				level++;
+
+			// Beyond the wheel range, will be placed again when the last level cascades.
+			if (level == levels - 1 && delta >= (uint64_t(1) << (levels * levelBits)))
+				expiry = m_current + (uint64_t(1) << (levels * levelBits)) - 1;
+
+			auto slot = (expiry >> (level * levelBits)) & slotMask;
+			link(index, level * slotsPerLevel + static_cast<uint32_t>(slot));
+		}
+
+		void link(uint32_t index, uint32_t slot)
+		{
+			auto& node = m_nodes[index];
+			node.slot = slot;
+			node.previous = invalidNode;
+			node.next = m_slots[slot];
+
+			if (node.next != invalidNode)
+				m_nodes[node.next].previous = index;
+
+			m_slots[slot] = index;
+
+			if (slot < pendingSlot)
+				m_occupied[slot / slotsPerLevel][(slot % slotsPerLevel) / 64] |= uint64_t(1) << (slot % 64);
+		}
+
+		void unlink(uint32_t index)
+		{
+			auto& node = m_nodes[index];
+
+			if (node.previous != invalidNode)
+				m_nodes[node.previous].next = node.next;
+			else
+				m_slots[node.slot] = node.next;
+
+			if (node.next != invalidNode)
+				m_nodes[node.next].previous = node.previous;
+
+			if (node.slot < pendingSlot && m_slots[node.slot] == invalidNode)
+				m_occupied[node.slot / slotsPerLevel][(node.slot % slotsPerLevel) / 64] &= ~(uint64_t(1) << (node.slot % 64));
+		}
+
+		// Takes every timer out of the slot and places it again relative to the current tick.
+		void cascade(uint64_t tick)
+		{
+			for (uint32_t level = 1; level < levels; level++)
+			{
+				auto index = (tick >> (level * levelBits)) & slotMask;
+				auto slot = level * slotsPerLevel + static_cast<uint32_t>(index);
+
+				while (m_slots[slot] != invalidNode)
+				{
+					auto node = m_slots[slot];
+					unlink(node);
+					place(node);
+				}
+
+				if (index != 0)
+					break;
+			}
+		}
+
+		void moveSlot(uint64_t from, uint32_t to)
+		{
+			while (m_slots[from] != invalidNode)
+			{
+				auto node = m_slots[from];
+				unlink(node);
+				link(node, to);
+			}
+		}
+
+		// Callbacks are free to add and cancel timers, including the ones being fired.
+		// Timers they add as already due are left for the next expire().
+		size_t firePending()
+		{
+			moveSlot(pendingSlot, firingSlot);
+
+			size_t fired = 0;
+			while (m_slots[firingSlot] != invalidNode)
+			{
+				auto index = m_slots[firingSlot];
+				unlink(index);
+				auto callback = std::move(m_nodes[index].callback);
+				releaseNode(index);
+				m_count--;
+				fired++;
+
+				if (callback)
+					callback();
+			}
+
+			return fired;
+		}
+
+		// First occupied slot of the level in the cyclic order from the start slot.
+		uint32_t findOccupied(uint32_t level, uint64_t start) const
+		{
+			const uint32_t words = slotsPerLevel / 64;
+			auto word = static_cast<uint32_t>(start / 64);
+			auto bit = static_cast<uint32_t>(start % 64);
+
+			auto bits = m_occupied[level][word] & (~uint64_t(0) << bit);
+			if (bits != 0)
+				return word * 64 + __builtin_ctzll(bits);
+
+			for (uint32_t i = 1; i <= words; i++)
+			{
+				auto current = (word + i) % words;
+				bits = m_occupied[level][current];
+
+				// Wrapped around to the low bits of the starting word.
+				if (i == words)
+					bits &= (uint64_t(1) << bit) - 1;
+
+				if (bits != 0)
+					return current * 64 + __builtin_ctzll(bits);
+			}
+
+			return invalidSlot;
+		}
+
+		static time_t currentTick()
+		{
+			if (tickNanoseconds == clocks::nanosecondsPerSecond)
+				return Clock::seconds();
+
+			return static_cast<time_t>(Clock::nanoseconds() / tickNanoseconds);
+		}
+
+		// Skips over the empty ticks up to the next occupied slot or the next cascade.
+		uint64_t nextInterestingTick(uint64_t tick, uint64_t target) const
+		{
+			auto nextCascade = (tick | slotMask) + 1;
+			auto slot = findOccupied(0, tick & slotMask);
+			auto next = nextCascade;
+
+			if (slot != invalidSlot)
+			{
+				auto occupied = tick + ((slot - tick) & slotMask);
+				if (occupied < next)
+					next = occupied;
+			}
+
+			return next < target + 1 ? next : target + 1;
+		}
+	};
+
+	using TimerWheel = BasicTimerWheel<>;
+
+	// Compares deadlines against the time 64 at once for BasicTimerArray. The kernel is picked
+	// at runtime from what the CPU supports, the same way as strings::Scanner does it.
+	class DeadlineSweep
+	{
+	public:
+		enum class Kernel
+		{
+			scalar,
+			sse42,
+			avx2
+		};
+
+		// Bit i is set when deadlines[i] <= now.
+		static uint64_t block(const int64_t* deadlines, int64_t now)
+		{
+			return kernels()[static_cast<int>(selectedKernel().load(std::memory_order_relaxed))](deadlines, now);
+		}
+
+		static uint64_t tail(const int64_t* deadlines, size_t length, int64_t now)
+		{
+			uint64_t bits = 0;
+			for (size_t i = 0; i < length; i++)
+				bits |= static_cast<uint64_t>(deadlines[i] <= now) << i;
+
+			return bits;
+		}
+
+		static Kernel getKernel() { return selectedKernel().load(); }
+
+		static bool isSupported(Kernel kernel)
+		{
+			switch (kernel)
+			{
+			case Kernel::scalar:
+				return true;
+#ifdef ARAP_TIMERS_X86
+			case Kernel::sse42:
+				return __builtin_cpu_supports("sse4.2");
+			case Kernel::avx2:
+				return __builtin_cpu_supports("avx2");
+#endif
+			default:
+				return false;
+			}
+		}
+
+		// Overrides the detected kernel, throws when the CPU lacks it.
+		static void setKernel(Kernel kernel)
+		{
+			if (!isSupported(kernel))
+				throw std::runtime_error("Deadline sweep kernel " + std::to_string(static_cast<int>(kernel)) + " is not supported by the CPU.");
+
+			selectedKernel().store(kernel);
+		}
+	private:
+		using Compare = uint64_t (*)(const int64_t*, int64_t);
+
+		static uint64_t blockScalar(const int64_t* deadlines, int64_t now) { return tail(deadlines, 64, now); }
+
+#ifdef ARAP_TIMERS_X86
+		__attribute__((target("sse4.2")))
+		static uint64_t blockSse42(const int64_t* deadlines, int64_t now)
+		{
+			uint64_t bits = 0;
+			auto nowVector = _mm_set1_epi64x(now);
+			for (uint32_t i = 0; i < 64; i += 2)
+			{
+				auto pending = _mm_cmpgt_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(deadlines + i)), nowVector);
+				auto mask = static_cast<uint64_t>(_mm_movemask_pd(_mm_castsi128_pd(pending)));
+				bits |= (~mask & 0x3) << i;
+			}
+
+			return bits;
+		}
+
+		__attribute__((target("avx2")))
+		static uint64_t blockAvx2(const int64_t* deadlines, int64_t now)
+		{
+			uint64_t bits = 0;
+			auto nowVector = _mm256_set1_epi64x(now);
+			for (uint32_t i = 0; i < 64; i += 4)
+			{
+				auto pending = _mm256_cmpgt_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(deadlines + i)), nowVector);
+				auto mask = static_cast<uint64_t>(_mm256_movemask_pd(_mm256_castsi256_pd(pending)));
+				bits |= (~mask & 0xF) << i;
+			}
+
+			return bits;
+		}
+#endif
+
+		// Indexed by Kernel.
+		static const Compare* kernels()
+		{
+#ifdef ARAP_TIMERS_X86
+			static const Compare table[] = {blockScalar, blockSse42, blockAvx2};
+#else
+			static const Compare table[] = {blockScalar};
+#endif
+			return table;
+		}
+
+		static Kernel detectKernel()
+		{
+#ifdef ARAP_TIMERS_X86
+			__builtin_cpu_init();
+#endif
+			if (isSupported(Kernel::avx2))
+				return Kernel::avx2;
+			if (isSupported(Kernel::sse42))
+				return Kernel::sse42;
+
+			return Kernel::scalar;
+		}
+
+		static std::atomic<Kernel>& selectedKernel()
+		{
+			static std::atomic<Kernel> kernel(detectKernel());
+			return kernel;
+		}
+
+		DeadlineSweep(){}
+		~DeadlineSweep(){}
+	};
+
+	// Batch of SimpleTimer-alike timers kept as structure of arrays. Sweeps read the clock
+	// once and compare all the deadlines with SIMD where the CPU supports it.
+	template <typename Clock = clocks::System>
+	class BasicTimerArray
+	{
+	public:
+		using Index = uint32_t;
+
+		BasicTimerArray(){}
+
+		Index add(uint32_t seconds = 0)
+		{
+			auto index = static_cast<Index>(m_durations.size());
+			m_deadlines.resize(index + 1);
+			m_durations.resize(index + 1);
+			m_pauseContinuum.resize(index + 1);
+
+			stop(index);
+			set(index, seconds);
+
+			return index;
+		}
+
+		void set(Index index, uint32_t seconds)
+		{
+			m_durations[index] = seconds;
+			restart(index);
+		}
+
+		// Start counting from the last timeout.
+		void reset(Index index)
+		{
+			if (m_deadlines[index] == stoppedDeadline)
+				return restart(index);
+
+			m_deadlines[index] += m_durations[index];
+			m_pauseContinuum[index] = notPaused;
+		}
+
+		// Start counting from now.
+		void restart(Index index)
+		{
+			if (m_durations[index] > 0)
+				m_deadlines[index] = Clock::seconds() + m_durations[index];
+
+			m_pauseContinuum[index] = notPaused;
+		}
+
+		void pause(Index index)
+		{
+			if (m_deadlines[index] == stoppedDeadline)
+				return;
+
+			auto now = Clock::seconds();
+			if (m_deadlines[index] <= now)
+				return;
+
+			m_pauseContinuum[index] = static_cast<uint32_t>(m_durations[index] - (m_deadlines[index] - now));
+			m_deadlines[index] = stoppedDeadline;
+		}
+
+		void stop(Index index)
+		{
+			m_deadlines[index] = stoppedDeadline;
+			m_pauseContinuum[index] = notPaused;
+		}
+
+		void run(Index index)
+		{
+			if (m_pauseContinuum[index] == notPaused)
+				return restart(index);
+
+			assert(m_pauseContinuum[index] < m_durations[index]);
+			m_deadlines[index] = Clock::seconds() + (m_durations[index] - m_pauseContinuum[index]);
+			m_pauseContinuum[index] = notPaused;
+		}
+
+		bool expired(Index index) const { return expired(index, Clock::seconds()); }
+		bool expired(Index index, time_t now) const { return m_deadlines[index] <= now; }
+
+		uint32_t elapsed(Index index) const { return elapsed(index, Clock::seconds()); }
+		uint32_t elapsed(Index index, time_t now) const
+		{
+			if (m_pauseContinuum[index] != notPaused)
+				return m_pauseContinuum[index];
+
+			if (m_deadlines[index] == stoppedDeadline)
+				return 0;
+
+			if (m_deadlines[index] <= now)
+				return m_durations[index];
+
+			return static_cast<uint32_t>(m_durations[index] - (m_deadlines[index] - now));
+		}
+
+		// Bit i of the mask is set when the timer i has expired, returns the count of expired timers.
+		size_t expired(std::vector<uint64_t>& bitmask) const { return expired(Clock::seconds(), bitmask); }
+		size_t expired(time_t now, std::vector<uint64_t>& bitmask) const
+		{
+			auto count = m_deadlines.size();
+			bitmask.assign((count + 63) / 64, 0);
+
+			size_t expiredCount = 0;
+			for (size_t word = 0; word < bitmask.size(); word++)
+			{
+				auto first = word * 64;
+				auto length = count - first < 64 ? count - first : 64;
+
+				bitmask[word] = length == 64 ? DeadlineSweep::block(m_deadlines.data() + first, now) : DeadlineSweep::tail(m_deadlines.data() + first, length, now);
+				expiredCount += __builtin_popcountll(bitmask[word]);
+			}
+
+			return expiredCount;
+		}
+
+		size_t expired(std::vector<Index>& indices) const { return expired(Clock::seconds(), indices); }
+		size_t expired(time_t now, std::vector<Index>& indices) const
+		{
+			indices.clear();
+
+			auto count = m_deadlines.size();
+			for (size_t first = 0; first < count; first += 64)
+			{
+				auto length = count - first < 64 ? count - first : 64;
+				auto bits = length == 64 ? DeadlineSweep::block(m_deadlines.data() + first, now) : DeadlineSweep::tail(m_deadlines.data() + first, length, now);
+
+				while (bits != 0)
+				{
+					indices.push_back(static_cast<Index>(first + __builtin_ctzll(bits)));
+					bits &= bits - 1;
+				}
+			}
+
+			return indices.size();
+		}
+
+		size_t size() const { return m_durations.size(); }
+
+		~BasicTimerArray(){}
+	private:
+		// Stopped and paused timers never compare as expired.
+		static const int64_t stoppedDeadline = std::numeric_limits<int64_t>::max();
+		static const uint32_t notPaused = std::numeric_limits<uint32_t>::max();
+
+		std::vector<int64_t> m_deadlines;
+		std::vector<uint32_t> m_durations;
+		std::vector<uint32_t> m_pauseContinuum;
+	};
+
+	using TimerArray = BasicTimerArray<>;
+
+	// Timer thread owning a millisecond TimerWheel on the monotonic clock. Any thread can arm
+	// and cancel through a lock-free command queue. Expirations either run the callback on the
+	// service thread or get delivered to a CompletionQueue that the arming thread drains.
+	class TimerService
+	{
+	public:
+		using Callback = std::function<void()>;
+		using Handle = uint64_t;
+
+		// Expirations for one consumer thread, the descriptor turns readable when there is
+		// something to dispatch. Has to outlive the timers armed with it.
+		class CompletionQueue
+		{
+		public:
+			CompletionQueue(size_t capacity = 1024) : m_completions(capacity)
+			{
+				m_eventDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+				if (m_eventDescriptor < 0)
+					throw std::runtime_error(std::string("eventfd() failed - ") + std::strerror(errno));
+			}
+
+			// Runs the delivered callbacks on the calling thread, returns their count.
+			size_t dispatch()
+			{
+				uint64_t counter;
+				auto readResult = read(m_eventDescriptor, &counter, sizeof(counter));
+				(void)readResult;
+
+				size_t dispatched = 0;
+				Callback callback;
+				while (m_completions.tryPop(callback))
+				{
+					dispatched++;
+					if (callback)
+						callback();
+				}
+
+				return dispatched;
+			}
+
+			int getFileDescriptor() const { return m_eventDescriptor; }
+
+			CompletionQueue(const CompletionQueue&) = delete;
+			CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+			~CompletionQueue()
+			{
+				close(m_eventDescriptor);
+			}
+		private:
+			friend class TimerService;
+
+			concurrent::MpscQueue<Callback> m_completions;
+			int m_eventDescriptor;
+
+			// Leaves the callback untouched when the queue is full.
+			bool deliver(Callback& callback)
+			{
+				if (!m_completions.tryPush(std::move(callback)))
+					return false;
+
+				uint64_t increment = 1;
+				auto writeResult = write(m_eventDescriptor, &increment, sizeof(increment));
+				(void)writeResult;
+
+				return true;
+			}
+		};
+
+		TimerService(size_t commandCapacity = 65536) : m_commands(commandCapacity), m_nextHandle(1), m_running(true), m_sleeping(false)
+		{
+			m_eventDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			if (m_eventDescriptor < 0)
+				throw std::runtime_error(std::string("eventfd() failed - ") + std::strerror(errno));
+
+			m_thread = std::thread(&TimerService::serve, this);
+		}
+
+		// Callback runs on the service thread.
+		Handle arm(std::chrono::milliseconds timeout, Callback callback)
+		{
+			return submitArm(timeout, std::move(callback), nullptr);
+		}
+
+		// Callback runs on the thread calling completions.dispatch().
+		Handle arm(std::chrono::milliseconds timeout, Callback callback, CompletionQueue& completions)
+		{
+			return submitArm(timeout, std::move(callback), &completions);
+		}
+
+		// No effect when the timer has already fired. Arming and cancelling from a callback running on the
+		// service thread is fine as well.
+		void cancel(Handle handle)
+		{
+			submit(Command{Command::cancelTimer, handle, 0, nullptr, nullptr});
+		}
+
+		TimerService(const TimerService&) = delete;
+		TimerService& operator=(const TimerService&) = delete;
+
+		// Timers not fired by now are dropped.
+		~TimerService()
+		{
+			m_running.store(false, std::memory_order_release);
+			wake();
+			m_thread.join();
+
+			close(m_eventDescriptor);
+		}
+	private:
+		static const int64_t nanosecondsPerTick = 1000000;
+
+		using Wheel = BasicTimerWheel<clocks::Monotonic, nanosecondsPerTick>;
+
+		struct Command
+		{
+			enum Type : uint8_t
+			{
+				armTimer,
+				cancelTimer
+			};
+
+			Type type;
+			Handle handle;
+			int64_t deadline;
+			Callback callback;
+			CompletionQueue* completions;
+		};
+
+		concurrent::MpscQueue<Command> m_commands;
+		std::atomic<Handle> m_nextHandle;
+		std::atomic<bool> m_running;
+		// Set while the service thread is about to block, producers wake it up only then.
+		std::atomic<bool> m_sleeping;
+		int m_eventDescriptor;
+		std::thread m_thread;
+		std::atomic<std::thread::id> m_serviceThread;
+		// Commands from the callbacks on the service thread, which cannot wait for itself to drain the queue.
+		std::vector<Command> m_ownCommands;
+
+		Handle submitArm(std::chrono::milliseconds timeout, Callback callback, CompletionQueue* completions)
+		{
+			auto handle = m_nextHandle.fetch_add(1, std::memory_order_relaxed);
+			auto deadline = Clock::monotonic() + std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+			submit(Command{Command::armTimer, handle, deadline, std::move(callback), completions});
+
+			return handle;
+		}
+
+		void submit(Command&& command)
+		{
+			if (std::this_thread::get_id() == m_serviceThread.load(std::memory_order_relaxed))
+			{
+				m_ownCommands.push_back(std::move(command));
+				return;
+			}
+
+			// Full queue means the service thread is behind, back off until it catches up.
+			while (!m_commands.tryPush(std::move(command)))
+				std::this_thread::yield();
+
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (m_sleeping.load(std::memory_order_relaxed) && m_sleeping.exchange(false))
+				wake();
+		}
+
+		void wake()
+		{
+			uint64_t increment = 1;
+			auto writeResult = write(m_eventDescriptor, &increment, sizeof(increment));
+			(void)writeResult;
+		}
+
+		void serve()
+		{
+			m_serviceThread.store(std::this_thread::get_id());
+
+			Wheel wheel;
+			std::unordered_map<Handle, Wheel::Id> timers;
+			std::vector<std::pair<CompletionQueue*, Callback>> undelivered;
+			std::vector<Command> ownCommands;
+			int64_t now = 0;
+
+			auto apply = [&](Command& command)
+				{
+					if (command.type == Command::cancelTimer)
+					{
+						auto timer = timers.find(command.handle);
+						if (timer == timers.end())
+							return;
+
+						wheel.cancel(timer->second);
+						timers.erase(timer);
+						return;
+					}
+
+					// Deadline rounded up to a tick, otherwise the timer could fire up to a tick early.
+					auto remaining = (command.deadline + nanosecondsPerTick - 1) / nanosecondsPerTick - now;
+					auto handle = command.handle;
+					auto completions = command.completions;
+					auto callback = std::move(command.callback);
+
+					timers[handle] = wheel.addTicks(remaining > 0 ? remaining : 0,
+						[&timers, &undelivered, handle, completions, callback]() mutable
+						{
+							timers.erase(handle);
+
+							if (completions == nullptr)
+							{
+								if (callback)
+									callback();
+							}
+							else if (!completions->deliver(callback))
+							{
+								undelivered.emplace_back(completions, std::move(callback));
+							}
+						});
+				};
+
+			while (m_running.load(std::memory_order_acquire))
+			{
+				// Brings the wheel time up to date before the new timeouts get counted from it.
+				now = static_cast<int64_t>(Clock::monotonic() / nanosecondsPerTick);
+				wheel.expire(now);
+
+				Command command;
+				while (m_commands.tryPop(command))
+					apply(command);
+
+				ownCommands.swap(m_ownCommands);
+				for (auto& own : ownCommands)
+					apply(own);
+				ownCommands.clear();
+
+				wheel.expire();
+
+				for (size_t i = 0; i < undelivered.size(); (void)0)
+				{
+					if (undelivered[i].first->deliver(undelivered[i].second))
+						undelivered.erase(undelivered.begin() + i);
+					else
+						i++;
+				}
+
+				m_sleeping.store(true, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+
+				if (!m_commands.empty() || !m_ownCommands.empty() || !m_running.load(std::memory_order_acquire))
+				{
+					m_sleeping.store(false, std::memory_order_relaxed);
+					continue;
+				}
+
+				auto timeout = wheel.nextTimeoutMilliseconds();
+				if (!undelivered.empty() && (timeout < 0 || timeout > 1))
+					timeout = 1;
+
+				if (timeout > std::numeric_limits<int>::max())
+					timeout = std::numeric_limits<int>::max();
+
+				struct pollfd pollDescriptor = {m_eventDescriptor, POLLIN, 0};
+				poll(&pollDescriptor, 1, static_cast<int>(timeout));
+				m_sleeping.store(false, std::memory_order_relaxed);
+
+				uint64_t counter;
+				auto readResult = read(m_eventDescriptor, &counter, sizeof(counter));
+				(void)readResult;
+			}
+		}
+	};
 }
@@ -1,6 +1,8 @@
 #include "ArapUtils.h"
+#include "ArapHash.h"
 
 #include <algorithm>
+#include <cerrno>
 #include <cstring>
 #include <exception>
 #include <functional>
@@ -11,6 +13,9 @@
 #include <climits>
 #include <cstdlib>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+
 namespace arap
 {
 	namespace linuxOS
@@ -298,6 +303,88 @@ namespace arap
 
 	namespace strings
 	{
+		namespace
+		{
+			// Strings of the InternPool are packed into blocks of this size, longer ones get their own.
+			const size_t internBlockSize = 64 * 1024;
+			const InternPool::Id emptySlot = std::numeric_limits<InternPool::Id>::max();
+
+			// Same set as std::isspace() in the classic locale.
+			inline bool isWhiteSpace(char character)
+			{
+				return character == ' ' || static_cast<unsigned char>(character - '\t') <= '\r' - '\t';
+			}
+
+			// Same splitting as getLines(std::ifstream&), but the newlines are searched blockwise by the
+			// Scanner. Lines lying within a block are passed without copying.
+			template <typename Sink>
+			void readLines(const std::string& filePath, Sink sink)
+			{
+				auto fileDescriptor = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+				if (fileDescriptor < 0)
+					throw std::runtime_error("Cannot open a file " + filePath + ".");
+
+				std::string line;
+				std::vector<char> buffer(64 * 1024);
+
+				while (true)
+				{
+					auto length = read(fileDescriptor, buffer.data(), buffer.size());
+					if (length < 0)
+					{
+						if (errno == EINTR)
+							continue;
+
+						auto description = Tools::getErrnoDescription();
+						close(fileDescriptor);
+						throw std::runtime_error("Reading " + filePath + " failed - " + description);
+					}
+
+					if (length == 0)
+						break;
+
+					const char* position = buffer.data();
+					const char* end = position + length;
+					while (true)
+					{
+						auto newline = Scanner::find(position, end, '\n');
+						if (newline == end)
+						{
+							line.append(position, end);
+							break;
+						}
+
+						if (line.empty())
+						{
+							sink(std::string_view(position, newline - position));
+						}
+						else
+						{
+							line.append(position, newline);
+							sink(std::string_view(line));
+							line.clear();
+						}
+
+						position = newline + 1;
+					}
+				}
+
+				close(fileDescriptor);
+
+				if (!line.empty())
+					sink(std::string_view(line));
+			}
+
+			// The text takes at most the size of the file, saves the regrowing.
+			template <typename Table>
+			void reserveText(const std::string& filePath, Table& lines)
+			{
+				struct stat status;
+				if (stat(filePath.c_str(), &status) == 0 && status.st_size > 0)
+					lines.reserve(0, status.st_size);
+			}
+		}
+
 		std::vector<std::string> Utilities::getLines(FILE* fileHandle)
 		{
 			std::vector<std::string> lines;
@@ -310,6 +397,8 @@ namespace arap
 				lines.emplace_back(lineBuffer);
 			}
 
+			free(lineBuffer);
+
 			return lines;
 		}
 		
@@ -335,18 +424,322 @@ namespace arap
 			
 		std::vector<std::string> Utilities::getLines(const std::string& filePath)
 		{
-			std::ifstream inputFile(filePath);
+			std::vector<std::string> lines;
+			readLines(filePath, [&lines](std::string_view line) { lines.emplace_back(line); });
 
-			if (inputFile.bad() || inputFile.is_open() == false)
-				throw std::runtime_error("Cannot open a file " + filePath + ".");
+			return lines;
+		}
 
-			auto lines = getLines(inputFile);
+		void Utilities::getLines(const std::string& filePath, LineTable& lines)
+		{
+			lines.clear();
+			reserveText(filePath, lines);
+			readLines(filePath, [&lines](std::string_view line) { lines.append(line); });
+		}
 
-			inputFile.close();
+		void Utilities::getLines(const std::string& filePath, LargeLineTable& lines)
+		{
+			lines.clear();
+			reserveText(filePath, lines);
+			readLines(filePath, [&lines](std::string_view line) { lines.append(line); });
+		}
 
-			return lines;
+		LineReader::LineReader(FILE* fileHandle) : m_fileHandle(fileHandle), m_fileStream(nullptr), m_ownsHandle(false), m_buffer(nullptr), m_bufferSize(0)
+		{}
+
+		LineReader::LineReader(std::ifstream& fileStream) : m_fileHandle(nullptr), m_fileStream(&fileStream), m_ownsHandle(false), m_buffer(nullptr), m_bufferSize(0)
+		{}
+
+		LineReader::LineReader(const std::string& filePath) : m_fileStream(nullptr), m_ownsHandle(true), m_buffer(nullptr), m_bufferSize(0)
+		{
+			m_fileHandle = fopen(filePath.c_str(), "re");
+			if (m_fileHandle == nullptr)
+				throw std::runtime_error("Cannot open a file " + filePath + " - " + Tools::getErrnoDescription());
+
+			posix_fadvise(fileno(m_fileHandle), 0, 0, POSIX_FADV_SEQUENTIAL);
 		}
-			
+
+		bool LineReader::next(std::string_view& line)
+		{
+			if (m_fileStream != nullptr)
+			{
+				// Failing getline() leaves the previous line in place.
+				m_streamLine.clear();
+				std::getline(*m_fileStream, m_streamLine);
+				// A stream gone bad would never reach the end.
+				if ((m_fileStream->eof() || m_fileStream->fail()) && m_streamLine.empty())
+					return false;
+
+				line = m_streamLine;
+				return true;
+			}
+
+			auto length = getline(&m_buffer, &m_bufferSize, m_fileHandle);
+			if (length <= 0)
+				return false;
+
+			if (m_buffer[length - 1] == '\n')
+				length--;
+
+			line = std::string_view(m_buffer, length);
+			return true;
+		}
+
+		LineReader::~LineReader()
+		{
+			free(m_buffer);
+
+			if (m_ownsHandle)
+				fclose(m_fileHandle);
+		}
+
+		Tokenizer::Iterator::Iterator(const char* position, const char* end, std::string_view delimiter) : m_end(end), m_delimiter(delimiter)
+		{
+			if (position == end)
+				return;
+
+			m_token = std::string_view(position, find(position, end, delimiter) - position);
+		}
+
+		Tokenizer::Iterator& Tokenizer::Iterator::operator++()
+		{
+			auto next = m_token.data() + m_token.size();
+			if (next != m_end)
+				next += m_delimiter.size();
+
+			*this = Iterator(next, m_end, m_delimiter);
+			return *this;
+		}
+
+		const char* Tokenizer::find(const char* begin, const char* end, std::string_view delimiter)
+		{
+			if (delimiter.empty())
+				return end;
+
+			auto rest = delimiter.size() - 1;
+			while (static_cast<size_t>(end - begin) > rest)
+			{
+				// Candidates by the first byte, only those get compared in full.
+				auto candidate = Scanner::find(begin, end - rest, delimiter[0]);
+				if (candidate == end - rest)
+					break;
+
+				if (std::memcmp(candidate + 1, delimiter.data() + 1, rest) == 0)
+					return candidate;
+
+				begin = candidate + 1;
+			}
+
+			return end;
+		}
+
+		InternPool::InternPool() : m_slots(64, Slot{0, emptySlot}), m_blockPosition(nullptr), m_blockLeft(0), m_arenaBytes(0)
+		{}
+
+		InternPool::Id InternPool::intern(std::string_view text)
+		{
+			auto hashed = hash(text);
+			auto index = findSlot(text, hashed);
+			if (m_slots[index].id != emptySlot)
+			{
+				m_counts[m_slots[index].id]++;
+				return m_slots[index].id;
+			}
+
+			// At most half full, so the probes stay short and there is always an empty slot.
+			if ((m_strings.size() + 1) * 2 > m_slots.size())
+			{
+				if (m_strings.size() >= std::numeric_limits<Id>::max() / 2)
+					throw std::runtime_error("Intern pool has run out of ids.");
+
+				grow();
+				index = findSlot(text, hashed);
+			}
+
+			auto id = static_cast<Id>(m_strings.size());
+			m_strings.push_back(store(text));
+			m_counts.push_back(1);
+			m_slots[index] = Slot{static_cast<uint32_t>(hashed), id};
+
+			return id;
+		}
+
+		bool InternPool::find(std::string_view text, Id& id) const
+		{
+			auto& slot = m_slots[findSlot(text, hash(text))];
+			if (slot.id == emptySlot)
+				return false;
+
+			id = slot.id;
+			return true;
+		}
+
+		std::string_view InternPool::at(Id id) const
+		{
+			if (id >= m_strings.size())
+				throw std::out_of_range("Id " + std::to_string(id) + " is out of the intern pool of " + std::to_string(m_strings.size()) + " strings.");
+
+			return m_strings[id];
+		}
+
+		size_t InternPool::getMemoryUsage() const
+		{
+			return m_arenaBytes + m_slots.capacity() * sizeof(Slot) + m_strings.capacity() * sizeof(std::string_view) + m_counts.capacity() * sizeof(uint64_t)
+				+ m_blocks.capacity() * sizeof(std::unique_ptr<char[]>);
+		}
+
+		uint64_t InternPool::hash(std::string_view text)
+		{
+			return Hash::bytes(text);
+		}
+
+		// Slot holding the text or the empty one where it would be inserted.
+		size_t InternPool::findSlot(std::string_view text, uint64_t hashed) const
+		{
+			auto mask = m_slots.size() - 1;
+			auto shortHash = static_cast<uint32_t>(hashed);
+			for (auto index = hashed & mask; ; index = (index + 1) & mask)
+			{
+				auto& slot = m_slots[index];
+				if (slot.id == emptySlot || (slot.hash == shortHash && m_strings[slot.id] == text))
+					return index;
+			}
+		}
+
+		std::string_view InternPool::store(std::string_view text)
+		{
+			if (text.size() > internBlockSize / 4)
+			{
+				m_blocks.emplace_back(new char[text.size()]);
+				m_arenaBytes += text.size();
+				std::memcpy(m_blocks.back().get(), text.data(), text.size());
+
+				return std::string_view(m_blocks.back().get(), text.size());
+			}
+
+			if (text.size() > m_blockLeft)
+			{
+				m_blocks.emplace_back(new char[internBlockSize]);
+				m_arenaBytes += internBlockSize;
+				m_blockPosition = m_blocks.back().get();
+				m_blockLeft = internBlockSize;
+			}
+
+			std::memcpy(m_blockPosition, text.data(), text.size());
+			std::string_view stored(m_blockPosition, text.size());
+			m_blockPosition += text.size();
+			m_blockLeft -= text.size();
+
+			return stored;
+		}
+
+		void InternPool::grow()
+		{
+			std::vector<Slot> slots(m_slots.size() * 2, Slot{0, emptySlot});
+			auto mask = slots.size() - 1;
+
+			// Only the kept low bits of the hash place the ids, the table never outgrows them.
+			for (auto& slot : m_slots)
+			{
+				if (slot.id == emptySlot)
+					continue;
+
+				auto index = slot.hash & mask;
+				while (slots[index].id != emptySlot)
+					index = (index + 1) & mask;
+
+				slots[index] = slot;
+			}
+
+			m_slots.swap(slots);
+		}
+
+		MappedLines::Iterator::Iterator(const char* position, const char* end) : m_end(end)
+		{
+			if (position == end)
+				return;
+
+			m_line = std::string_view(position, Scanner::find(position, end, '\n') - position);
+		}
+
+		MappedLines::Iterator& MappedLines::Iterator::operator++()
+		{
+			auto next = m_line.data() + m_line.size();
+			if (next != m_end)
+				next++;
+
+			*this = Iterator(next, m_end);
+			return *this;
+		}
+
+		MappedLines::MappedLines(const std::string& filePath) : m_data(nullptr), m_size(0)
+		{
+			auto fileDescriptor = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fileDescriptor < 0)
+				throw std::runtime_error("Cannot open a file " + filePath + " - " + Tools::getErrnoDescription());
+
+			struct stat status;
+			if (fstat(fileDescriptor, &status) != 0)
+			{
+				auto description = Tools::getErrnoDescription();
+				close(fileDescriptor);
+				throw std::runtime_error("fstat() failed for " + filePath + " - " + description);
+			}
+
+			// Zero length mapping is not allowed, an empty file just has no lines.
+			if (status.st_size > 0)
+			{
+				auto mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+				if (mapping == MAP_FAILED)
+				{
+					auto description = Tools::getErrnoDescription();
+					close(fileDescriptor);
+					throw std::runtime_error("mmap() failed for " + filePath + " - " + description);
+				}
+
+				madvise(mapping, status.st_size, MADV_SEQUENTIAL);
+				m_data = static_cast<const char*>(mapping);
+				m_size = status.st_size;
+			}
+
+			// The mapping stays valid after closing.
+			close(fileDescriptor);
+		}
+
+		MappedLines::~MappedLines()
+		{
+			if (m_data != nullptr)
+				munmap(const_cast<char*>(m_data), m_size);
+		}
+
+		std::vector<std::string_view> ParallelLines::getChunks(std::string_view data, size_t count)
+		{
+			std::vector<std::string_view> chunks;
+			if (count == 0)
+				count = 1;
+
+			auto target = (data.size() + count - 1) / count;
+			const char* position = data.data();
+			const char* end = position + data.size();
+
+			while (position != end)
+			{
+				// Extended to the end of the line the even cut falls into.
+				auto cut = static_cast<size_t>(end - position) > target ? position + target : end;
+				if (cut != end)
+				{
+					cut = Scanner::find(cut - 1, end, '\n');
+					if (cut != end)
+						cut++;
+				}
+
+				chunks.emplace_back(position, cut - position);
+				position = cut;
+			}
+
+			return chunks;
+		}
+
 		void Utilities::writeToFile(const std::string& path, const std::string& data, bool overwrite)
 		{
 			auto options = std::ios_base::out;
@@ -364,24 +757,66 @@ namespace arap
 		std::vector<std::string> Utilities::split(const std::string& source, const std::string& delimiter)
 		{
 			std::vector<std::string> elements;
-			std::stringstream sourceStream(source);
-
-			std::string splittedString;
-			while (std::getline(sourceStream, splittedString, delimiter.c_str()[0]))
-			{
-				elements.push_back(splittedString);
-			}
+			Tokenizer(source, delimiter).appendTo(elements);
 
 			return elements;
 		}
 
+		// The classic locale only knows ASCII white space, so the bytes are classified directly.
 		std::string Utilities::removeWhiteSpace(std::string& source)
 		{
-			source.erase(std::remove_if(source.begin(), source.end(),
-					std::bind(std::isspace<char>, std::placeholders::_1, std::locale::classic())), source.end());
+			auto end = Scanner::removeWhiteSpace(&source[0], &source[0] + source.size());
+			source.resize(end - source.data());
 
 			return source;
 		}
+
+		std::string_view Utilities::trim(std::string_view source)
+		{
+			return trimRight(trimLeft(source));
+		}
+
+		std::string_view Utilities::trimLeft(std::string_view source)
+		{
+			size_t start = 0;
+			while (start < source.size() && isWhiteSpace(source[start]))
+				start++;
+
+			return source.substr(start);
+		}
+
+		std::string_view Utilities::trimRight(std::string_view source)
+		{
+			auto length = source.size();
+			while (length > 0 && isWhiteSpace(source[length - 1]))
+				length--;
+
+			return source.substr(0, length);
+		}
+
+		void Utilities::collapseWhiteSpace(std::string& source)
+		{
+			size_t output = 0;
+			bool pendingSpace = false;
+			for (auto character : source)
+			{
+				if (isWhiteSpace(character))
+				{
+					pendingSpace = output > 0;
+					continue;
+				}
+
+				if (pendingSpace)
+				{
+					source[output++] = ' ';
+					pendingSpace = false;
+				}
+
+				source[output++] = character;
+			}
+
+			source.resize(output);
+		}
 	}
 	
 	uint32_t Tools::getTime24h(bool gmt)
@@ -1,14 +1,25 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
 #include <ctime>
 #include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <limits>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "ArapConcurrent.h"
+
 namespace arap
 {
 	namespace universe
@@ -67,6 +78,8 @@ namespace arap
 			void sendData(const std::vector<uint8_t>& data);
 			void sendMessage(const std::string& message);
 
+			int getFileDescriptor() const { return m_fileDescriptor; }
+
 			~SerialPort();
 		private:
 			void writeData(const uint8_t* data, size_t length);
@@ -76,25 +89,685 @@ namespace arap
 
 			int m_fileDescriptor;
 		};
+
+		// Whole file reads and writes of many small files at once. Every phase - open, read or write,
+		// close - is submitted for the whole batch through io_uring when the kernel allows it,
+		// otherwise the files are handled by a thread pool. Not thread safe.
+		class BatchFileIo
+		{
+		public:
+			enum class Backend
+			{
+				ioUring,
+				threadPool
+			};
+
+			struct ReadResult
+			{
+				std::string data;
+				// errno of the failed step, 0 on success.
+				int error;
+			};
+
+			struct WriteRequest
+			{
+				std::string path;
+				std::string data;
+			};
+
+			// io_uring when available, the thread pool otherwise.
+			BatchFileIo();
+			// Throws when the backend asked for is not available.
+			BatchFileIo(Backend backend);
+
+			Backend getBackend() const { return m_ring ? Backend::ioUring : Backend::threadPool; }
+
+			// Results in the order of the paths.
+			std::vector<ReadResult> readFiles(const std::vector<std::string>& paths);
+			// Replaces the content of the files or appends to it, errno per file in the order of the requests.
+			std::vector<int> writeFiles(const std::vector<WriteRequest>& requests, bool overwrite = true);
+
+			BatchFileIo(const BatchFileIo&) = delete;
+			BatchFileIo& operator=(const BatchFileIo&) = delete;
+
+			~BatchFileIo();
+		private:
+			class Ring;
+
+			std::unique_ptr<Ring> m_ring;
+			std::unique_ptr<concurrent::ThreadPool> m_pool;
+		};
 	}
 
 	namespace strings
 	{
+		// Lines kept in one contiguous buffer indexed by an array of offsets, instead of an allocation
+		// per line. The views handed out are valid until the next append().
+		template <typename Offset>
+		class BasicLineTable
+		{
+		public:
+			class Iterator
+			{
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = std::string_view;
+				using difference_type = std::ptrdiff_t;
+				using pointer = void;
+				using reference = std::string_view;
+
+				Iterator(const BasicLineTable* table, size_t index) : m_table(table), m_index(index) {}
+
+				std::string_view operator*() const { return (*m_table)[m_index]; }
+
+				Iterator& operator++() { m_index++; return *this; }
+				Iterator operator++(int) { auto previous = *this; m_index++; return previous; }
+
+				bool operator==(const Iterator& other) const { return m_index == other.m_index; }
+				bool operator!=(const Iterator& other) const { return m_index != other.m_index; }
+			private:
+				const BasicLineTable* m_table;
+				size_t m_index;
+			};
+
+			BasicLineTable() : m_offsets(1, 0)
+			{}
+
+			void append(std::string_view line)
+			{
+				if (line.size() > std::numeric_limits<Offset>::max() - m_text.size())
+					throw std::runtime_error("Line table text exceeds the range of its offsets.");
+
+				m_text.append(line.data(), line.size());
+				m_offsets.push_back(static_cast<Offset>(m_text.size()));
+			}
+
+			std::string_view operator[](size_t index) const
+			{
+				return std::string_view(m_text.data() + m_offsets[index], m_offsets[index + 1] - m_offsets[index]);
+			}
+
+			std::string_view at(size_t index) const
+			{
+				if (index >= size())
+					throw std::out_of_range("Line " + std::to_string(index) + " is out of the table of " + std::to_string(size()) + " lines.");
+
+				return (*this)[index];
+			}
+
+			Iterator begin() const { return Iterator(this, 0); }
+			Iterator end() const { return Iterator(this, size()); }
+
+			size_t size() const { return m_offsets.size() - 1; }
+			bool empty() const { return m_offsets.size() == 1; }
+
+			void reserve(size_t lines, size_t characters)
+			{
+				m_offsets.reserve(lines + 1);
+				m_text.reserve(characters);
+			}
+
+			void clear()
+			{
+				m_text.clear();
+				m_offsets.resize(1);
+			}
+
+			// Bytes allocated for the text and the offsets.
+			size_t getMemoryUsage() const { return m_text.capacity() + m_offsets.capacity() * sizeof(Offset); }
+		private:
+			std::string m_text;
+			// Start of every line followed by the end of the last one.
+			std::vector<Offset> m_offsets;
+		};
+
+		// Up to 4 GiB of text.
+		using LineTable = BasicLineTable<uint32_t>;
+		using LargeLineTable = BasicLineTable<uint64_t>;
+
+		// Distinct strings stored once in an arena and known by a compact id, the ids are handed out in
+		// the order of the first occurrence. Every intern() is counted, so a histogram of the distinct
+		// lines or tokens takes one pass. Views stay valid for the lifetime of the pool. Not thread safe.
+		class InternPool
+		{
+		public:
+			using Id = uint32_t;
+
+			InternPool();
+
+			// Stores the text on its first occurrence.
+			Id intern(std::string_view text);
+			// False when the text has not been interned, nothing is counted.
+			bool find(std::string_view text, Id& id) const;
+
+			std::string_view operator[](Id id) const { return m_strings[id]; }
+			std::string_view at(Id id) const;
+
+			// Occurrences interned, indexed by the id.
+			const std::vector<uint64_t>& getCounts() const { return m_counts; }
+			uint64_t getCount(Id id) const { return m_counts.at(id); }
+
+			size_t size() const { return m_strings.size(); }
+			bool empty() const { return m_strings.empty(); }
+
+			// Bytes allocated for the arena, the table and the per id data.
+			size_t getMemoryUsage() const;
+
+			InternPool(const InternPool&) = delete;
+			InternPool& operator=(const InternPool&) = delete;
+		private:
+			// Open addressing with linear probing, the low bits of the hash are kept for the comparisons
+			// and for the rehashing.
+			struct Slot
+			{
+				uint32_t hash;
+				Id id;
+			};
+
+			std::vector<Slot> m_slots;
+			std::vector<std::string_view> m_strings;
+			std::vector<uint64_t> m_counts;
+			std::vector<std::unique_ptr<char[]>> m_blocks;
+			char* m_blockPosition;
+			size_t m_blockLeft;
+			size_t m_arenaBytes;
+
+			static uint64_t hash(std::string_view text);
+			size_t findSlot(std::string_view text, uint64_t hashed) const;
+			std::string_view store(std::string_view text);
+			void grow();
+		};
+
 		class Utilities
 		{
 		public:
 			static std::vector<std::string> getLines(FILE* fileHandle);		
 			static std::vector<std::string> getLines(std::ifstream& fileStream);		
 			static std::vector<std::string> getLines(const std::string& filePath);
+			// Same lines as above, replacing the earlier content of the table.
+			static void getLines(const std::string& filePath, LineTable& lines);
+			static void getLines(const std::string& filePath, LargeLineTable& lines);
 
 			static void writeToFile(const std::string& path, const std::string& data, bool overwrite = true);
 			
 			static std::vector<std::string> split(const std::string& source, const std::string& delimiter);
 			static std::string removeWhiteSpace(std::string& source);
+
+			// White space as in the classic locale, the views point into the source.
+			static std::string_view trim(std::string_view source);
+			static std::string_view trimLeft(std::string_view source);
+			static std::string_view trimRight(std::string_view source);
+			// Trims and replaces every inner run of white space with a single space, in place.
+			static void collapseWhiteSpace(std::string& source);
 		private:
 			Utilities(){}
 			~Utilities(){}
 		};
+
+		// Byte search kernels, the widest one the CPU supports is picked at the first use.
+		class Scanner
+		{
+		public:
+			enum class Kernel
+			{
+				scalar,
+				sse2,
+				avx2,
+				avx512
+			};
+
+			// Pointer to the first occurrence of the byte, end when there is none.
+			static const char* find(const char* begin, const char* end, char byte);
+			static size_t count(const char* begin, const char* end, char byte);
+			// Compacts the bytes other than ASCII white space to the front in place, returns the new end.
+			static char* removeWhiteSpace(char* begin, char* end);
+
+			static Kernel getKernel();
+			static bool isSupported(Kernel kernel);
+			// Overrides the detected kernel, throws when the CPU lacks it.
+			static void setKernel(Kernel kernel);
+		private:
+			Scanner(){}
+			~Scanner(){}
+		};
+
+		// Lazy split on every occurrence of the whole delimiter, the tokens are views into the source.
+		// Same rules as split() - an empty source has no tokens and a delimiter at the end of the source
+		// does not start an empty token.
+		class Tokenizer
+		{
+		public:
+			class Iterator
+			{
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = std::string_view;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const std::string_view*;
+				using reference = const std::string_view&;
+
+				Iterator() : m_end(nullptr) {}
+				Iterator(const char* position, const char* end, std::string_view delimiter);
+
+				reference operator*() const { return m_token; }
+				pointer operator->() const { return &m_token; }
+
+				Iterator& operator++();
+				Iterator operator++(int) { auto previous = *this; ++*this; return previous; }
+
+				bool operator==(const Iterator& other) const { return m_token.data() == other.m_token.data(); }
+				bool operator!=(const Iterator& other) const { return !(*this == other); }
+			private:
+				std::string_view m_token;
+				const char* m_end;
+				std::string_view m_delimiter;
+			};
+
+			Tokenizer(std::string_view source, std::string_view delimiter) : m_source(source), m_delimiter(delimiter)
+			{}
+
+			Iterator begin() const { return Iterator(m_source.data(), m_source.data() + m_source.size(), m_delimiter); }
+			Iterator end() const { return Iterator(); }
+
+			// Appends the tokens to a container of string views or strings, returns the count of them.
+			// Reusing the container between calls keeps the hot path free of allocations.
+			template <typename Container>
+			size_t appendTo(Container& tokens) const
+			{
+				size_t count = 0;
+				for (auto token : *this)
+				{
+					tokens.emplace_back(token);
+					count++;
+				}
+
+				return count;
+			}
+
+			// Same as appendTo() but the tokens are interned and their ids appended.
+			template <typename Container>
+			size_t appendIdsTo(InternPool& pool, Container& ids) const
+			{
+				size_t count = 0;
+				for (auto token : *this)
+				{
+					ids.push_back(pool.intern(token));
+					count++;
+				}
+
+				return count;
+			}
+
+			// First occurrence of the delimiter, end when there is none.
+			static const char* find(const char* begin, const char* end, std::string_view delimiter);
+		private:
+			std::string_view m_source;
+			std::string_view m_delimiter;
+		};
+
+		// Reads the lines one at a time into one reused buffer, so the memory is bounded by the longest
+		// line and not by the file. A line stays valid until the next one is read. Lines are split
+		// the same way as getLines(const std::string&) does. Handles and streams given are not owned.
+		class LineReader
+		{
+		public:
+			class Iterator
+			{
+			public:
+				using iterator_category = std::input_iterator_tag;
+				using value_type = std::string_view;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const std::string_view*;
+				using reference = const std::string_view&;
+
+				Iterator() : m_reader(nullptr) {}
+				explicit Iterator(LineReader* reader) : m_reader(reader) { ++*this; }
+
+				reference operator*() const { return m_line; }
+				pointer operator->() const { return &m_line; }
+
+				Iterator& operator++()
+				{
+					if (!m_reader->next(m_line))
+						m_reader = nullptr;
+
+					return *this;
+				}
+
+				bool operator==(const Iterator& other) const { return m_reader == other.m_reader; }
+				bool operator!=(const Iterator& other) const { return !(*this == other); }
+			private:
+				LineReader* m_reader;
+				std::string_view m_line;
+			};
+
+			LineReader(FILE* fileHandle);
+			LineReader(std::ifstream& fileStream);
+			LineReader(const std::string& filePath);
+
+			// False when there are no more lines.
+			bool next(std::string_view& line);
+
+			Iterator begin() { return Iterator(this); }
+			Iterator end() { return Iterator(); }
+
+			LineReader(const LineReader&) = delete;
+			LineReader& operator=(const LineReader&) = delete;
+
+			~LineReader();
+		private:
+			FILE* m_fileHandle;
+			std::ifstream* m_fileStream;
+			bool m_ownsHandle;
+			char* m_buffer;
+			size_t m_bufferSize;
+			std::string m_streamLine;
+		};
+
+		// Lines of a memory mapped file as views into the mapping, valid while the object lives.
+		// Lines are split the same way as getLines() does - without the newline and a newline at
+		// the end of the file does not start an empty line.
+		class MappedLines
+		{
+		public:
+			class Iterator
+			{
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = std::string_view;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const std::string_view*;
+				using reference = const std::string_view&;
+
+				Iterator() : m_end(nullptr) {}
+				Iterator(const char* position, const char* end);
+
+				reference operator*() const { return m_line; }
+				pointer operator->() const { return &m_line; }
+
+				Iterator& operator++();
+				Iterator operator++(int) { auto previous = *this; ++*this; return previous; }
+
+				bool operator==(const Iterator& other) const { return m_line.data() == other.m_line.data(); }
+				bool operator!=(const Iterator& other) const { return !(*this == other); }
+			private:
+				std::string_view m_line;
+				const char* m_end;
+			};
+
+			MappedLines(const std::string& filePath);
+
+			Iterator begin() const { return Iterator(m_data, m_data + m_size); }
+			Iterator end() const { return Iterator(); }
+
+			// Whole content of the file.
+			std::string_view data() const { return std::string_view(m_data, m_size); }
+			std::vector<std::string_view> getLines() const { return std::vector<std::string_view>(begin(), end()); }
+
+			MappedLines(const MappedLines&) = delete;
+			MappedLines& operator=(const MappedLines&) = delete;
+
+			~MappedLines();
+		private:
+			const char* m_data;
+			size_t m_size;
+		};
+
+		// Keeps a file open for appending and buffers the data, instead of opening the file on every
+		// write like writeToFile() does. Appends that do not fit the buffer go out together with it
+		// in one writev(). Not thread safe.
+		class FileAppender
+		{
+		public:
+			enum class Durability
+			{
+				// Left to the kernel writeback.
+				none,
+				// fdatasync() after every syncBytes written.
+				everyBytes,
+				// fdatasync() on every flush.
+				everyFlush
+			};
+
+			struct Policy
+			{
+				// Flushed when the buffered data reaches it.
+				size_t bufferBytes;
+				// Flushed on append or flushIfDue() when the oldest buffered data is older.
+				std::chrono::milliseconds maxDelay;
+				Durability durability;
+				size_t syncBytes;
+			};
+
+			static Policy defaultPolicy() { return Policy{64 * 1024, std::chrono::milliseconds(1000), Durability::none, 0}; }
+
+			FileAppender(const std::string& path);
+			FileAppender(const std::string& path, const Policy& policy);
+
+			void append(std::string_view data);
+			void append(const std::vector<uint8_t>& data) { append(std::string_view(reinterpret_cast<const char*>(data.data()), data.size())); }
+
+			// Writes the buffered data out, syncs when the durability asks for it.
+			void flush();
+			// For event loops - flushes when the delay of the policy has passed, returns true then.
+			bool flushIfDue();
+			// Flushes and fdatasync()s regardless of the policy.
+			void sync();
+
+			size_t getBufferedBytes() const { return m_buffer.size(); }
+			// Total handed to the file so far, a failed write counts the part that got through.
+			uint64_t getWrittenBytes() const { return m_writtenBytes; }
+			int getFileDescriptor() const { return m_fileDescriptor; }
+
+			FileAppender(const FileAppender&) = delete;
+			FileAppender& operator=(const FileAppender&) = delete;
+
+			// Flushes what is left, errors are lost here.
+			~FileAppender();
+		private:
+			std::string m_path;
+			Policy m_policy;
+			int m_fileDescriptor;
+			std::string m_buffer;
+			// Monotonic time of the first byte in the buffer.
+			int64_t m_bufferedSince;
+			size_t m_unsyncedBytes;
+			uint64_t m_writtenBytes;
+
+			void write(std::string_view extra);
+			void keepUnwritten(std::string_view extra, size_t done);
+			void written(size_t bytes);
+		};
+
+		// Takes the file output off the hot threads. Producers enqueue into a lock-free ring, one
+		// background thread drains it and commits everything collected for a file at once - one
+		// write and, depending on the durability of the policy, one fdatasync() per file and batch.
+		class AsyncWriter
+		{
+		public:
+			enum class Overflow
+			{
+				// write() returns false and the data is counted as dropped.
+				drop,
+				// write() waits for room in the queue.
+				wait
+			};
+
+			struct Statistics
+			{
+				// Handed over to the files.
+				uint64_t writtenBytes;
+				uint64_t droppedBytes;
+				uint64_t droppedWrites;
+				// Writes that found the queue full, dropped or waited.
+				uint64_t backpressureEvents;
+				uint64_t commits;
+			};
+
+			// Files are addressed by their index in paths. The buffer size of the policy bounds the data
+			// coalesced per file in one write, the delay is not used.
+			AsyncWriter(const std::vector<std::string>& paths, Overflow overflow = Overflow::drop, size_t queueCapacity = 16384);
+			AsyncWriter(const std::vector<std::string>& paths, const FileAppender::Policy& policy, Overflow overflow, size_t queueCapacity);
+
+			// Thread safe, false when the data was dropped.
+			bool write(size_t file, std::string_view data);
+			// Blocks until everything written before is committed, rethrows a failure of the writer thread.
+			void flush();
+
+			Statistics getStatistics() const;
+
+			AsyncWriter(const AsyncWriter&) = delete;
+			AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+			// Commits everything enqueued before returning.
+			~AsyncWriter();
+		private:
+			static const size_t inlineBytes = 104;
+			static const uint32_t flushMarker = std::numeric_limits<uint32_t>::max();
+			static const int retryMilliseconds = 100;
+
+			// Short data is carried inline, longer in the string.
+			struct Entry
+			{
+				uint32_t file;
+				uint32_t length;
+				char inlineData[inlineBytes];
+				std::string data;
+			};
+
+			std::vector<std::unique_ptr<FileAppender>> m_files;
+			concurrent::MpscQueue<Entry> m_queue;
+			Overflow m_overflow;
+			std::atomic<bool> m_running;
+			std::atomic<bool> m_sleeping;
+			int m_eventDescriptor;
+
+			std::atomic<uint64_t> m_writtenBytes;
+			std::atomic<uint64_t> m_droppedBytes;
+			std::atomic<uint64_t> m_droppedWrites;
+			std::atomic<uint64_t> m_backpressureEvents;
+			std::atomic<uint64_t> m_commits;
+
+			std::mutex m_flushMutex;
+			std::condition_variable m_flushed;
+			uint64_t m_nextFlushTicket;
+			uint64_t m_committedFlushTicket;
+			std::exception_ptr m_failure;
+
+			std::thread m_thread;
+
+			void enqueue(Entry&& entry);
+			void wake();
+			void serve();
+			// True when a file is left with a failed flush.
+			bool commit(std::vector<bool>& touched);
+		};
+
+		// Follows a growing file like tail -F. Only the bytes appended since the previous read() are read,
+		// and only complete lines are delivered, an unfinished one waits for its newline. A truncated file
+		// is read again from its beginning. A rotated one - the path renamed or removed and created anew -
+		// is read to its end before switching over to the new file. Changes are watched with inotify on
+		// the directory of the file. Not thread safe.
+		class FileFollower
+		{
+		public:
+			// Starts after the last complete line of the file, or from its beginning. The file does not
+			// need to exist yet, its directory does.
+			FileFollower(const std::string& filePath, bool fromStart = false);
+
+			// Lines without the newlines, valid for the duration of the callback. Returns the count of them.
+			size_t read(const std::function<void(std::string_view)>& callback);
+			// Appends to the lines.
+			size_t read(std::vector<std::string>& lines);
+
+			// Blocks until the file changes, false when the timeout passed first.
+			bool wait(std::chrono::milliseconds timeout);
+
+			// Readable on changes in the directory of the file, for epoll or poll. Drained by read().
+			int getFileDescriptor() const { return m_inotifyDescriptor; }
+			// Bytes of the current file consumed, the unfinished line included.
+			uint64_t getOffset() const { return m_offset; }
+
+			FileFollower(const FileFollower&) = delete;
+			FileFollower& operator=(const FileFollower&) = delete;
+
+			~FileFollower();
+		private:
+			std::string m_path;
+			// Name within the directory, to match the inotify events.
+			std::string m_name;
+			int m_inotifyDescriptor;
+			// -1 while the file does not exist.
+			int m_fileDescriptor;
+			uint64_t m_offset;
+			std::string m_unfinished;
+			std::vector<char> m_buffer;
+
+			bool openFile();
+			bool drainEvents();
+			size_t readAppended(const std::function<void(std::string_view)>& callback);
+		};
+
+		// Line processing of a whole buffer, e.g. MappedLines::data(), on a thread pool. The buffer is cut
+		// into chunks at line boundaries and the lines are split as MappedLines does.
+		class ParallelLines
+		{
+		public:
+			// At most count chunks, every one but the last ends with a newline.
+			static std::vector<std::string_view> getChunks(std::string_view data, size_t count);
+
+			// The callback runs concurrently on the pool threads, the order of the lines is not kept.
+			template <typename Callback>
+			static void forEachLine(concurrent::ThreadPool& pool, std::string_view data, Callback callback)
+			{
+				concurrent::ThreadPool::Group group(pool);
+				for (auto chunk : getChunks(data, pool.size() * chunksPerThread))
+				{
+					group.submit([chunk, &callback]()
+						{
+							for (MappedLines::Iterator line(chunk.data(), chunk.data() + chunk.size()), end; line != end; ++line)
+								callback(*line);
+						});
+				}
+
+				group.wait();
+			}
+
+			// Every chunk folds its lines with map(Result&, std::string_view) into a copy of identity, the
+			// chunk results are combined by reduce(Result&, Result&&) in the order of the chunks, so the
+			// outcome does not depend on the scheduling.
+			template <typename Result, typename Map, typename Reduce>
+			static Result mapReduce(concurrent::ThreadPool& pool, std::string_view data, const Result& identity, Map map, Reduce reduce)
+			{
+				auto chunks = getChunks(data, pool.size() * chunksPerThread);
+				std::vector<Result> partials(chunks.size(), identity);
+
+				concurrent::ThreadPool::Group group(pool);
+				for (size_t i = 0; i < chunks.size(); i++)
+				{
+					group.submit([&chunks, &partials, &map, i]()
+						{
+							auto chunk = chunks[i];
+							for (MappedLines::Iterator line(chunk.data(), chunk.data() + chunk.size()), end; line != end; ++line)
+								map(partials[i], *line);
+						});
+				}
+
+				group.wait();
+
+				Result total = identity;
+				for (auto& partial : partials)
+					reduce(total, std::move(partial));
+
+				return total;
+			}
+		private:
+			// More chunks than threads evens out the chunks of uneven cost.
+			static const size_t chunksPerThread = 4;
+
+			ParallelLines(){}
+			~ParallelLines(){}
+		};
 	}
 
 	class Tools
@@ -179,6 +852,9 @@ namespace arap
 			std::vector<uint8_t> getData();
 			// In order to get the sender, first the getData must be called!!!
 			std::string getSender();
+
+			// For blocking in poll()/epoll() together with other descriptors, e.g. DescriptorTimer.
+			int getFileDescriptor() const { return m_socketDescriptor; }
 		private:
 			std::string m_ip;
 			std::string m_senderIp;
@@ -0,0 +1,430 @@
+// Ahead of ArapUtils.h for the same reason as in ArapUtilsFiles.cpp.
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "ArapUtils.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+
+namespace arap
+{
+	namespace linuxOS
+	{
+		namespace
+		{
+			const size_t firstRead = 4096;
+			const size_t maxRead = 1 << 30;
+			const unsigned ringEntries = 256;
+
+			// One file of a batch passing through the phases.
+			struct Job
+			{
+				const char* path;
+				int fileDescriptor;
+				int error;
+				std::string* data;
+				const std::string* source;
+				size_t offset;
+				size_t requested;
+				bool done;
+			};
+
+			// Doubles the buffer with every read, small files are not paying for zeroing a large one.
+			size_t nextRead(Job& job)
+			{
+				job.requested = std::min(std::max(firstRead, job.offset), maxRead);
+				job.data->resize(job.offset + job.requested);
+				return job.requested;
+			}
+
+			int openFlags(bool reading, bool overwrite)
+			{
+				if (reading)
+					return O_RDONLY | O_CLOEXEC;
+
+				return O_WRONLY | O_CREAT | O_CLOEXEC | (overwrite ? O_TRUNC : O_APPEND);
+			}
+
+			// Synchronous counterpart of the ring phases for the thread pool.
+			void runJob(Job& job, bool reading, bool overwrite)
+			{
+				job.fileDescriptor = open(job.path, openFlags(reading, overwrite), 0644);
+				if (job.fileDescriptor < 0)
+				{
+					job.error = errno;
+					return;
+				}
+
+				while (job.error == 0)
+				{
+					ssize_t count;
+					if (reading)
+					{
+						auto length = nextRead(job);
+						count = read(job.fileDescriptor, &(*job.data)[job.offset], length);
+					}
+					else
+					{
+						if (job.offset == job.source->size())
+							break;
+
+						count = write(job.fileDescriptor, job.source->data() + job.offset, job.source->size() - job.offset);
+					}
+
+					if (count < 0)
+					{
+						if (errno != EINTR)
+							job.error = errno;
+
+						continue;
+					}
+
+					job.offset += count;
+					if (reading && count == 0)
+						break;
+				}
+
+				if (reading)
+					job.data->resize(job.offset);
+
+				// Deferred write errors (EIO, EDQUOT, NFS) show up only here.
+				if (close(job.fileDescriptor) != 0 && job.error == 0)
+					job.error = errno;
+			}
+		}
+
+		// Minimal io_uring over the raw system calls, liburing is not required.
+		class BatchFileIo::Ring
+		{
+		public:
+			Ring()
+			{
+				struct io_uring_params parameters;
+				std::memset(&parameters, 0, sizeof(parameters));
+
+				m_fileDescriptor = static_cast<int>(syscall(__NR_io_uring_setup, ringEntries, &parameters));
+				if (m_fileDescriptor < 0)
+					throw std::runtime_error("io_uring_setup() failed - " + Tools::getErrnoDescription());
+
+				// Writes at the current position of an appending file need -1 as the offset.
+				const unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_RW_CUR_POS | IORING_FEAT_NODROP;
+				if ((parameters.features & required) != required)
+				{
+					close(m_fileDescriptor);
+					throw std::runtime_error("io_uring of the kernel lacks the features needed.");
+				}
+
+				m_ringSize = std::max(parameters.sq_off.array + parameters.sq_entries * sizeof(unsigned),
+					parameters.cq_off.cqes + parameters.cq_entries * sizeof(struct io_uring_cqe));
+				m_ring = mmap(nullptr, m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fileDescriptor, IORING_OFF_SQ_RING);
+				if (m_ring == MAP_FAILED)
+				{
+					auto description = Tools::getErrnoDescription();
+					close(m_fileDescriptor);
+					throw std::runtime_error("Mapping the io_uring rings failed - " + description);
+				}
+
+				m_entriesSize = parameters.sq_entries * sizeof(struct io_uring_sqe);
+				auto entries = mmap(nullptr, m_entriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fileDescriptor, IORING_OFF_SQES);
+				if (entries == MAP_FAILED)
+				{
+					auto description = Tools::getErrnoDescription();
+					munmap(m_ring, m_ringSize);
+					close(m_fileDescriptor);
+					throw std::runtime_error("Mapping the io_uring submission entries failed - " + description);
+				}
+
+				auto ring = static_cast<char*>(m_ring);
+				m_entries = static_cast<struct io_uring_sqe*>(entries);
+				m_submissionTail = reinterpret_cast<unsigned*>(ring + parameters.sq_off.tail);
+				m_submissionMask = *reinterpret_cast<unsigned*>(ring + parameters.sq_off.ring_mask);
+				m_submissionArray = reinterpret_cast<unsigned*>(ring + parameters.sq_off.array);
+				m_submissionCapacity = parameters.sq_entries;
+				m_completionHead = reinterpret_cast<unsigned*>(ring + parameters.cq_off.head);
+				m_completionTail = reinterpret_cast<unsigned*>(ring + parameters.cq_off.tail);
+				m_completionMask = *reinterpret_cast<unsigned*>(ring + parameters.cq_off.ring_mask);
+				m_completions = reinterpret_cast<struct io_uring_cqe*>(ring + parameters.cq_off.cqes);
+			}
+
+			// One operation for every job in the list, prepare() fills the submission entry of a job and
+			// complete() gets its result. Never more operations in flight than the ring holds.
+			template <typename Prepare, typename Complete>
+			void run(const std::vector<size_t>& jobs, Prepare prepare, Complete complete)
+			{
+				size_t next = 0;
+				unsigned inFlight = 0;
+				// Queued in the ring, but not taken by the kernel yet.
+				unsigned unsubmitted = 0;
+
+				while (next < jobs.size() || inFlight > 0 || unsubmitted > 0)
+				{
+					unsigned queued = 0;
+					auto tail = *m_submissionTail;
+					while (next < jobs.size() && inFlight + unsubmitted + queued < m_submissionCapacity)
+					{
+						auto index = tail & m_submissionMask;
+						auto& entry = m_entries[index];
+						std::memset(&entry, 0, sizeof(entry));
+						prepare(entry, jobs[next]);
+						entry.user_data = jobs[next];
+						m_submissionArray[index] = index;
+
+						tail++;
+						queued++;
+						next++;
+					}
+					__atomic_store_n(m_submissionTail, tail, __ATOMIC_RELEASE);
+					unsubmitted += queued;
+
+					// Submits what the kernel has not taken yet and waits for at least one completion. The
+					// kernel may take only a part, the rest stays in the ring for the next round.
+					while (true)
+					{
+						auto result = syscall(__NR_io_uring_enter, m_fileDescriptor, unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+						if (result >= 0)
+						{
+							inFlight += static_cast<unsigned>(result);
+							unsubmitted -= static_cast<unsigned>(result);
+							break;
+						}
+
+						if (errno == EINTR)
+							continue;
+
+						// Out of resources for now, the completions of the ones in flight free them.
+						if ((errno == EAGAIN || errno == EBUSY) && inFlight > 0)
+						{
+							result = syscall(__NR_io_uring_enter, m_fileDescriptor, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+							if (result >= 0 || errno == EINTR)
+								break;
+						}
+
+						throw std::runtime_error("io_uring_enter() failed - " + Tools::getErrnoDescription());
+					}
+
+					auto head = *m_completionHead;
+					auto completionTail = __atomic_load_n(m_completionTail, __ATOMIC_ACQUIRE);
+					for (; head != completionTail; head++)
+					{
+						auto& completion = m_completions[head & m_completionMask];
+						complete(static_cast<size_t>(completion.user_data), completion.res);
+						inFlight--;
+					}
+					__atomic_store_n(m_completionHead, head, __ATOMIC_RELEASE);
+				}
+			}
+
+			// Phases over the ring: open everything, read or write until every file is done, close.
+			void transfer(std::vector<Job>& jobs, bool reading, bool overwrite);
+
+			Ring(const Ring&) = delete;
+			Ring& operator=(const Ring&) = delete;
+
+			~Ring()
+			{
+				munmap(m_entries, m_entriesSize);
+				munmap(m_ring, m_ringSize);
+				close(m_fileDescriptor);
+			}
+		private:
+			int m_fileDescriptor;
+			void* m_ring;
+			size_t m_ringSize;
+			struct io_uring_sqe* m_entries;
+			size_t m_entriesSize;
+			unsigned* m_submissionTail;
+			unsigned m_submissionMask;
+			unsigned* m_submissionArray;
+			unsigned m_submissionCapacity;
+			unsigned* m_completionHead;
+			unsigned* m_completionTail;
+			unsigned m_completionMask;
+			struct io_uring_cqe* m_completions;
+		};
+
+		void BatchFileIo::Ring::transfer(std::vector<Job>& jobs, bool reading, bool overwrite)
+		{
+			std::vector<size_t> active(jobs.size());
+			for (size_t i = 0; i < jobs.size(); i++)
+				active[i] = i;
+
+			auto flags = openFlags(reading, overwrite);
+			run(active,
+				[&jobs, flags](struct io_uring_sqe& entry, size_t index)
+				{
+					entry.opcode = IORING_OP_OPENAT;
+					entry.fd = AT_FDCWD;
+					entry.addr = reinterpret_cast<uint64_t>(jobs[index].path);
+					entry.open_flags = flags;
+					entry.len = 0644;
+				},
+				[&jobs](size_t index, int result)
+				{
+					if (result < 0)
+						jobs[index].error = -result;
+					else
+						jobs[index].fileDescriptor = result;
+				});
+
+			auto pending = [&jobs, reading]()
+				{
+					std::vector<size_t> indexes;
+					for (size_t i = 0; i < jobs.size(); i++)
+					{
+						if (jobs[i].error == 0 && !jobs[i].done && (reading || jobs[i].offset < jobs[i].source->size()))
+							indexes.push_back(i);
+					}
+
+					return indexes;
+				};
+
+			// Small files take one round, longer reads and short writes come back for more.
+			for (auto indexes = pending(); !indexes.empty(); indexes = pending())
+			{
+				run(indexes,
+					[&jobs, reading](struct io_uring_sqe& entry, size_t index)
+					{
+						auto& job = jobs[index];
+						entry.fd = job.fileDescriptor;
+
+						if (reading)
+						{
+							entry.len = static_cast<uint32_t>(nextRead(job));
+							entry.opcode = IORING_OP_READ;
+							entry.addr = reinterpret_cast<uint64_t>(&(*job.data)[job.offset]);
+							entry.off = job.offset;
+						}
+						else
+						{
+							entry.opcode = IORING_OP_WRITE;
+							entry.addr = reinterpret_cast<uint64_t>(job.source->data() + job.offset);
+							entry.len = static_cast<uint32_t>(std::min<size_t>(job.source->size() - job.offset, maxRead));
+							entry.off = static_cast<uint64_t>(-1);
+						}
+					},
+					[&jobs, reading](size_t index, int result)
+					{
+						auto& job = jobs[index];
+						if (result == -EINTR || result == -EAGAIN)
+							return;
+
+						if (result < 0)
+						{
+							job.error = -result;
+							return;
+						}
+
+						job.offset += result;
+						if (reading && static_cast<size_t>(result) < job.requested)
+							job.done = true;
+					});
+			}
+
+			std::vector<size_t> opened;
+			for (size_t i = 0; i < jobs.size(); i++)
+			{
+				if (reading)
+					jobs[i].data->resize(jobs[i].offset);
+
+				if (jobs[i].fileDescriptor >= 0)
+					opened.push_back(i);
+			}
+
+			run(opened,
+				[&jobs](struct io_uring_sqe& entry, size_t index)
+				{
+					entry.opcode = IORING_OP_CLOSE;
+					entry.fd = jobs[index].fileDescriptor;
+				},
+				[&jobs](size_t index, int result)
+				{
+					// Same as in runJob(), a write may fail only at closing.
+					if (result < 0 && jobs[index].error == 0)
+						jobs[index].error = -result;
+				});
+		}
+
+		BatchFileIo::BatchFileIo()
+		{
+			try
+			{
+				m_ring.reset(new Ring());
+			}
+			catch (const std::runtime_error&)
+			{
+				m_pool.reset(new concurrent::ThreadPool());
+			}
+		}
+
+		BatchFileIo::BatchFileIo(Backend backend)
+		{
+			if (backend == Backend::ioUring)
+				m_ring.reset(new Ring());
+			else
+				m_pool.reset(new concurrent::ThreadPool());
+		}
+
+		std::vector<BatchFileIo::ReadResult> BatchFileIo::readFiles(const std::vector<std::string>& paths)
+		{
+			std::vector<ReadResult> results(paths.size());
+			std::vector<Job> jobs(paths.size());
+			for (size_t i = 0; i < paths.size(); i++)
+				jobs[i] = Job{paths[i].c_str(), -1, 0, &results[i].data, nullptr, 0, 0, false};
+
+			if (m_ring)
+			{
+				m_ring->transfer(jobs, true, false);
+			}
+			else
+			{
+				for (auto& job : jobs)
+					m_pool->submit([&job]() { runJob(job, true, false); });
+
+				m_pool->wait();
+			}
+
+			for (size_t i = 0; i < paths.size(); i++)
+			{
+				results[i].error = jobs[i].error;
+				if (jobs[i].error != 0)
+					results[i].data.clear();
+			}
+
+			return results;
+		}
+
+		std::vector<int> BatchFileIo::writeFiles(const std::vector<WriteRequest>& requests, bool overwrite)
+		{
+			std::vector<Job> jobs(requests.size());
+			for (size_t i = 0; i < requests.size(); i++)
+				jobs[i] = Job{requests[i].path.c_str(), -1, 0, nullptr, &requests[i].data, 0, 0, false};
+
+			if (m_ring)
+			{
+				m_ring->transfer(jobs, false, overwrite);
+			}
+			else
+			{
+				for (auto& job : jobs)
+					m_pool->submit([&job, overwrite]() { runJob(job, false, overwrite); });
+
+				m_pool->wait();
+			}
+
+			std::vector<int> errors(requests.size());
+			for (size_t i = 0; i < requests.size(); i++)
+				errors[i] = jobs[i].error;
+
+			return errors;
+		}
+
+		BatchFileIo::~BatchFileIo()
+		{}
+	}
+}
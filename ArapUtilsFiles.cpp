@@ -0,0 +1,663 @@
+// Ahead of ArapUtils.h, which includes the socket headers inside of its network namespace and
+// would take struct iovec along there.
+#include <sys/uio.h>
+
+#include "ArapUtils.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+#include "ArapClock.h"
+
+namespace arap
+{
+	namespace strings
+	{
+		FileAppender::FileAppender(const std::string& path) : FileAppender(path, defaultPolicy())
+		{}
+
+		FileAppender::FileAppender(const std::string& path, const Policy& policy) : m_path(path), m_policy(policy), m_bufferedSince(0), m_unsyncedBytes(0), m_writtenBytes(0)
+		{
+			if (m_policy.durability == Durability::everyBytes && m_policy.syncBytes == 0)
+				throw std::runtime_error("FileAppender syncing every N bytes needs a non zero syncBytes.");
+
+			m_fileDescriptor = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+			if (m_fileDescriptor < 0)
+				throw std::runtime_error("Opening " + path + " was not successful - " + Tools::getErrnoDescription());
+
+			m_buffer.reserve(m_policy.bufferBytes);
+		}
+
+		void FileAppender::append(std::string_view data)
+		{
+			if (m_buffer.size() + data.size() > m_policy.bufferBytes)
+			{
+				write(data);
+				return;
+			}
+
+			if (m_buffer.empty())
+				m_bufferedSince = Clock::monotonicCoarse();
+
+			m_buffer.append(data.data(), data.size());
+			flushIfDue();
+		}
+
+		void FileAppender::flush()
+		{
+			if (!m_buffer.empty())
+				write(std::string_view());
+		}
+
+		bool FileAppender::flushIfDue()
+		{
+			if (m_buffer.empty())
+				return false;
+
+			if (m_buffer.size() < m_policy.bufferBytes &&
+				Clock::monotonicCoarse() - m_bufferedSince < std::chrono::duration_cast<std::chrono::nanoseconds>(m_policy.maxDelay).count())
+				return false;
+
+			flush();
+			return true;
+		}
+
+		void FileAppender::sync()
+		{
+			if (!m_buffer.empty())
+				write(std::string_view());
+
+			if (fdatasync(m_fileDescriptor) != 0)
+				throw std::runtime_error("fdatasync() failed for " + m_path + " - " + Tools::getErrnoDescription());
+
+			m_unsyncedBytes = 0;
+		}
+
+		FileAppender::~FileAppender()
+		{
+			try
+			{
+				flush();
+			}
+			catch (...)
+			{}
+
+			close(m_fileDescriptor);
+		}
+
+		// The buffer and the extra data in one system call, partial writes are continued.
+		void FileAppender::write(std::string_view extra)
+		{
+			struct iovec parts[2] = {
+				{const_cast<char*>(m_buffer.data()), m_buffer.size()},
+				{const_cast<char*>(extra.data()), extra.size()}};
+			struct iovec* part = parts;
+			int partCount = 2;
+			size_t total = m_buffer.size() + extra.size();
+			size_t done = 0;
+
+			while (partCount > 0)
+			{
+				if (part->iov_len == 0)
+				{
+					part++;
+					partCount--;
+					continue;
+				}
+
+				auto count = writev(m_fileDescriptor, part, partCount);
+				if (count < 0)
+				{
+					if (errno == EINTR)
+						continue;
+
+					auto description = Tools::getErrnoDescription();
+					keepUnwritten(extra, done);
+					throw std::runtime_error("Writing to " + m_path + " failed - " + description);
+				}
+
+				done += count;
+				auto remaining = static_cast<size_t>(count);
+				while (partCount > 0 && remaining >= part->iov_len)
+				{
+					remaining -= part->iov_len;
+					part++;
+					partCount--;
+				}
+
+				if (partCount > 0)
+				{
+					part->iov_base = static_cast<char*>(part->iov_base) + remaining;
+					part->iov_len -= remaining;
+				}
+			}
+
+			m_buffer.clear();
+			written(total);
+		}
+
+		// After a failed write only what did not reach the file stays buffered, so that it is not written
+		// twice. The extra data counts as appended once any of it got written.
+		void FileAppender::keepUnwritten(std::string_view extra, size_t done)
+		{
+			auto bufferDone = std::min(done, m_buffer.size());
+			m_buffer.erase(0, bufferDone);
+			m_unsyncedBytes += done;
+			m_writtenBytes += done;
+
+			auto extraDone = done - bufferDone;
+			if (extraDone == 0)
+				return;
+
+			if (m_buffer.empty())
+				m_bufferedSince = Clock::monotonicCoarse();
+
+			m_buffer.append(extra.data() + extraDone, extra.size() - extraDone);
+		}
+
+		void FileAppender::written(size_t bytes)
+		{
+			m_unsyncedBytes += bytes;
+			m_writtenBytes += bytes;
+
+			if (m_policy.durability == Durability::everyFlush ||
+				(m_policy.durability == Durability::everyBytes && m_unsyncedBytes >= m_policy.syncBytes))
+			{
+				if (fdatasync(m_fileDescriptor) != 0)
+					throw std::runtime_error("fdatasync() failed for " + m_path + " - " + Tools::getErrnoDescription());
+
+				m_unsyncedBytes = 0;
+			}
+		}
+
+		AsyncWriter::AsyncWriter(const std::vector<std::string>& paths, Overflow overflow, size_t queueCapacity) :
+			AsyncWriter(paths, FileAppender::defaultPolicy(), overflow, queueCapacity)
+		{}
+
+		AsyncWriter::AsyncWriter(const std::vector<std::string>& paths, const FileAppender::Policy& policy, Overflow overflow, size_t queueCapacity) :
+			m_queue(queueCapacity), m_overflow(overflow), m_running(true), m_sleeping(false), m_writtenBytes(0), m_droppedBytes(0),
+			m_droppedWrites(0), m_backpressureEvents(0), m_commits(0), m_nextFlushTicket(0), m_committedFlushTicket(0)
+		{
+			// Commits are driven by the writer thread, the appenders must not flush on their own timer.
+			auto appenderPolicy = policy;
+			appenderPolicy.maxDelay = std::chrono::hours(24);
+
+			for (auto& path : paths)
+				m_files.emplace_back(new FileAppender(path, appenderPolicy));
+
+			m_eventDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			if (m_eventDescriptor < 0)
+				throw std::runtime_error("eventfd() failed - " + Tools::getErrnoDescription());
+
+			m_thread = std::thread(&AsyncWriter::serve, this);
+		}
+
+		bool AsyncWriter::write(size_t file, std::string_view data)
+		{
+			if (file >= m_files.size())
+				throw std::out_of_range("AsyncWriter has no file " + std::to_string(file) + ".");
+
+			Entry entry;
+			entry.file = static_cast<uint32_t>(file);
+			entry.length = static_cast<uint32_t>(data.size());
+			if (data.size() <= inlineBytes)
+				std::memcpy(entry.inlineData, data.data(), data.size());
+			else
+				entry.data.assign(data.data(), data.size());
+
+			if (!m_queue.tryPush(std::move(entry)))
+			{
+				m_backpressureEvents.fetch_add(1, std::memory_order_relaxed);
+
+				if (m_overflow == Overflow::drop)
+				{
+					m_droppedWrites.fetch_add(1, std::memory_order_relaxed);
+					m_droppedBytes.fetch_add(data.size(), std::memory_order_relaxed);
+					return false;
+				}
+
+				enqueue(std::move(entry));
+				return true;
+			}
+
+			wake();
+			return true;
+		}
+
+		void AsyncWriter::flush()
+		{
+			uint64_t ticket;
+			{
+				std::lock_guard<std::mutex> lock(m_flushMutex);
+				ticket = ++m_nextFlushTicket;
+			}
+
+			Entry marker;
+			marker.file = flushMarker;
+			marker.length = 0;
+			enqueue(std::move(marker));
+
+			std::unique_lock<std::mutex> lock(m_flushMutex);
+			m_flushed.wait(lock, [this, ticket]() { return m_committedFlushTicket >= ticket; });
+
+			if (m_failure)
+				std::rethrow_exception(std::exchange(m_failure, nullptr));
+		}
+
+		AsyncWriter::Statistics AsyncWriter::getStatistics() const
+		{
+			return Statistics{m_writtenBytes.load(), m_droppedBytes.load(), m_droppedWrites.load(), m_backpressureEvents.load(), m_commits.load()};
+		}
+
+		AsyncWriter::~AsyncWriter()
+		{
+			m_running.store(false, std::memory_order_release);
+			uint64_t increment = 1;
+			auto writeResult = ::write(m_eventDescriptor, &increment, sizeof(increment));
+			(void)writeResult;
+			m_thread.join();
+
+			close(m_eventDescriptor);
+		}
+
+		// Full queue means the writer thread is behind, back off until it catches up.
+		void AsyncWriter::enqueue(Entry&& entry)
+		{
+			while (!m_queue.tryPush(std::move(entry)))
+				std::this_thread::yield();
+
+			wake();
+		}
+
+		void AsyncWriter::wake()
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (m_sleeping.load(std::memory_order_relaxed) && m_sleeping.exchange(false))
+			{
+				uint64_t increment = 1;
+				auto writeResult = ::write(m_eventDescriptor, &increment, sizeof(increment));
+				(void)writeResult;
+			}
+		}
+
+		void AsyncWriter::serve()
+		{
+			std::vector<bool> touched(m_files.size(), false);
+			uint64_t pendingFlushTicket = 0;
+			bool pendingRetry = false;
+			Entry entry;
+
+			while (true)
+			{
+				// A batch is bounded by the queue capacity, steady producers must not hold the commit back.
+				size_t drained = 0;
+				while (drained < m_queue.capacity() && m_queue.tryPop(entry))
+				{
+					drained++;
+
+					if (entry.file == flushMarker)
+					{
+						pendingFlushTicket++;
+						continue;
+					}
+
+					auto& file = *m_files[entry.file];
+					auto before = file.getWrittenBytes() + file.getBufferedBytes();
+					try
+					{
+						auto data = entry.length <= inlineBytes ? std::string_view(entry.inlineData, entry.length) : std::string_view(entry.data);
+						file.append(data);
+						touched[entry.file] = true;
+						m_writtenBytes.fetch_add(entry.length, std::memory_order_relaxed);
+					}
+					catch (...)
+					{
+						// The part the file took - written or kept buffered for the next commit - is not lost.
+						touched[entry.file] = true;
+						auto accepted = std::min<uint64_t>(file.getWrittenBytes() + file.getBufferedBytes() - before, entry.length);
+						m_writtenBytes.fetch_add(accepted, std::memory_order_relaxed);
+						if (accepted < entry.length)
+						{
+							m_droppedWrites.fetch_add(1, std::memory_order_relaxed);
+							m_droppedBytes.fetch_add(entry.length - accepted, std::memory_order_relaxed);
+						}
+
+						std::lock_guard<std::mutex> lock(m_flushMutex);
+						if (!m_failure)
+							m_failure = std::current_exception();
+					}
+				}
+
+				if (drained > 0)
+				{
+					// Whatever arrived while the previous batch was written goes out as one commit.
+					pendingRetry = commit(touched);
+
+					if (pendingFlushTicket > 0)
+					{
+						{
+							std::lock_guard<std::mutex> lock(m_flushMutex);
+							m_committedFlushTicket += pendingFlushTicket;
+						}
+
+						pendingFlushTicket = 0;
+						m_flushed.notify_all();
+					}
+
+					continue;
+				}
+
+				if (!m_running.load(std::memory_order_acquire))
+					break;
+
+				m_sleeping.store(true, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+
+				if (!m_queue.empty() || !m_running.load(std::memory_order_acquire))
+				{
+					m_sleeping.store(false, std::memory_order_relaxed);
+					continue;
+				}
+
+				// Files left with a failed flush are retried without waiting for new data.
+				struct pollfd pollDescriptor = {m_eventDescriptor, POLLIN, 0};
+				auto woken = poll(&pollDescriptor, 1, pendingRetry ? retryMilliseconds : -1);
+				m_sleeping.store(false, std::memory_order_relaxed);
+
+				if (woken > 0)
+				{
+					uint64_t counter;
+					auto readResult = read(m_eventDescriptor, &counter, sizeof(counter));
+					(void)readResult;
+				}
+				else if (woken == 0)
+				{
+					pendingRetry = commit(touched);
+				}
+			}
+		}
+
+		bool AsyncWriter::commit(std::vector<bool>& touched)
+		{
+			bool pending = false;
+			for (size_t i = 0; i < m_files.size(); i++)
+			{
+				if (!touched[i])
+					continue;
+
+				// A failed flush keeps the data buffered and the file touched, the next commit tries again.
+				try
+				{
+					m_files[i]->flush();
+					touched[i] = false;
+				}
+				catch (...)
+				{
+					pending = true;
+
+					std::lock_guard<std::mutex> lock(m_flushMutex);
+					if (!m_failure)
+						m_failure = std::current_exception();
+				}
+			}
+
+			m_commits.fetch_add(1, std::memory_order_relaxed);
+			return pending;
+		}
+
+		FileFollower::FileFollower(const std::string& filePath, bool fromStart) : m_path(filePath), m_fileDescriptor(-1), m_offset(0), m_buffer(64 * 1024)
+		{
+			auto slash = filePath.rfind('/');
+			auto directory = slash == std::string::npos ? std::string(".") : filePath.substr(0, std::max<size_t>(slash, 1));
+			m_name = slash == std::string::npos ? filePath : filePath.substr(slash + 1);
+
+			m_inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if (m_inotifyDescriptor < 0)
+				throw std::runtime_error("inotify_init1() failed - " + Tools::getErrnoDescription());
+
+			// Watching the directory covers the writes as well as the renames and the creation of the file.
+			auto mask = IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+			if (inotify_add_watch(m_inotifyDescriptor, directory.c_str(), mask) < 0)
+			{
+				auto description = Tools::getErrnoDescription();
+				close(m_inotifyDescriptor);
+				throw std::runtime_error("Watching " + directory + " was not successful - " + description);
+			}
+
+			try
+			{
+				if (!openFile() || fromStart)
+					return;
+
+				// Back to the end of the last complete line, the unfinished one gets delivered once done.
+				// Without any newline the file is followed from its beginning.
+				struct stat status;
+				if (fstat(m_fileDescriptor, &status) != 0)
+					throw std::runtime_error("fstat() of " + m_path + " failed - " + Tools::getErrnoDescription());
+
+				uint64_t end = status.st_size;
+				while (end > 0)
+				{
+					auto length = std::min<uint64_t>(end, m_buffer.size());
+					auto result = pread(m_fileDescriptor, m_buffer.data(), length, end - length);
+					if (result < 0)
+						throw std::runtime_error("Reading " + m_path + " failed - " + Tools::getErrnoDescription());
+
+					auto newline = static_cast<const char*>(memrchr(m_buffer.data(), '\n', result));
+					if (newline != nullptr)
+					{
+						m_offset = end - length + (newline - m_buffer.data()) + 1;
+						break;
+					}
+
+					// Truncated in the meantime.
+					if (result == 0)
+						break;
+
+					end -= length;
+				}
+			}
+			catch (...)
+			{
+				if (m_fileDescriptor >= 0)
+					close(m_fileDescriptor);
+
+				close(m_inotifyDescriptor);
+				throw;
+			}
+		}
+
+		size_t FileFollower::read(const std::function<void(std::string_view)>& callback)
+		{
+			drainEvents();
+
+			if (m_fileDescriptor < 0 && !openFile())
+				return 0;
+
+			auto count = readAppended(callback);
+
+			struct stat current;
+			struct stat named;
+			if (fstat(m_fileDescriptor, &current) != 0)
+				throw std::runtime_error("fstat() of " + m_path + " failed - " + Tools::getErrnoDescription());
+
+			// Rotated when the path leads to another file or to none.
+			if (stat(m_path.c_str(), &named) == 0 && named.st_ino == current.st_ino && named.st_dev == current.st_dev)
+				return count;
+
+			// Whatever got written to the old one in the meantime, the unfinished line is never completed there.
+			count += readAppended(callback);
+			if (!m_unfinished.empty())
+			{
+				callback(m_unfinished);
+				count++;
+			}
+
+			close(m_fileDescriptor);
+			m_fileDescriptor = -1;
+
+			if (openFile())
+				count += readAppended(callback);
+
+			return count;
+		}
+
+		size_t FileFollower::read(std::vector<std::string>& lines)
+		{
+			return read([&lines](std::string_view line) { lines.emplace_back(line); });
+		}
+
+		bool FileFollower::wait(std::chrono::milliseconds timeout)
+		{
+			// Saturated, a timeout past the range of the clock waits for good.
+			auto now = std::chrono::steady_clock::now();
+			auto untilEnd = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::time_point::max() - now);
+			auto deadline = timeout < untilEnd ? now + timeout : std::chrono::steady_clock::time_point::max();
+
+			while (true)
+			{
+				// Longer waits than poll() takes are done in steps.
+				auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+				remaining = std::clamp<int64_t>(remaining, 0, std::numeric_limits<int>::max());
+
+				struct pollfd descriptor = {m_inotifyDescriptor, POLLIN, 0};
+				auto result = poll(&descriptor, 1, static_cast<int>(remaining));
+				if (result < 0)
+				{
+					if (errno == EINTR)
+						continue;
+
+					throw std::runtime_error("poll() of the inotify descriptor failed - " + Tools::getErrnoDescription());
+				}
+
+				if (result == 0)
+					return false;
+
+				// Other files of the directory wake it up as well.
+				if (drainEvents())
+					return true;
+			}
+		}
+
+		FileFollower::~FileFollower()
+		{
+			if (m_fileDescriptor >= 0)
+				close(m_fileDescriptor);
+
+			close(m_inotifyDescriptor);
+		}
+
+		bool FileFollower::openFile()
+		{
+			m_fileDescriptor = open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (m_fileDescriptor < 0)
+			{
+				if (errno == ENOENT)
+					return false;
+
+				throw std::runtime_error("Opening " + m_path + " was not successful - " + Tools::getErrnoDescription());
+			}
+
+			m_offset = 0;
+			m_unfinished.clear();
+			return true;
+		}
+
+		// True when any of the events concerned the followed file.
+		bool FileFollower::drainEvents()
+		{
+			alignas(struct inotify_event) char buffer[4096];
+			bool relevant = false;
+
+			while (true)
+			{
+				auto length = ::read(m_inotifyDescriptor, buffer, sizeof(buffer));
+				if (length < 0)
+				{
+					if (errno == EINTR)
+						continue;
+
+					if (errno == EAGAIN)
+						return relevant;
+
+					throw std::runtime_error("Reading the inotify descriptor failed - " + Tools::getErrnoDescription());
+				}
+
+				for (auto position = buffer; position < buffer + length; )
+				{
+					auto event = reinterpret_cast<const struct inotify_event*>(position);
+					if ((event->mask & IN_Q_OVERFLOW) || (event->len > 0 && m_name == event->name))
+						relevant = true;
+
+					position += sizeof(struct inotify_event) + event->len;
+				}
+			}
+		}
+
+		size_t FileFollower::readAppended(const std::function<void(std::string_view)>& callback)
+		{
+			struct stat status;
+			if (fstat(m_fileDescriptor, &status) != 0)
+				throw std::runtime_error("fstat() of " + m_path + " failed - " + Tools::getErrnoDescription());
+
+			// Truncation shows only while the file is shorter than the offset, as with tail -F.
+			if (static_cast<uint64_t>(status.st_size) < m_offset)
+			{
+				m_offset = 0;
+				m_unfinished.clear();
+			}
+
+			size_t count = 0;
+			while (true)
+			{
+				auto length = pread(m_fileDescriptor, m_buffer.data(), m_buffer.size(), m_offset);
+				if (length < 0)
+				{
+					if (errno == EINTR)
+						continue;
+
+					throw std::runtime_error("Reading " + m_path + " failed - " + Tools::getErrnoDescription());
+				}
+
+				if (length == 0)
+					return count;
+
+				m_offset += length;
+
+				const char* position = m_buffer.data();
+				const char* end = position + length;
+				while (true)
+				{
+					auto newline = Scanner::find(position, end, '\n');
+					if (newline == end)
+					{
+						m_unfinished.append(position, end);
+						break;
+					}
+
+					if (m_unfinished.empty())
+					{
+						callback(std::string_view(position, newline - position));
+					}
+					else
+					{
+						m_unfinished.append(position, newline);
+						callback(std::string_view(m_unfinished));
+						m_unfinished.clear();
+					}
+
+					count++;
+					position = newline + 1;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,346 @@
+#include "ArapUtils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ARAP_SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace arap
+{
+	namespace strings
+	{
+		namespace
+		{
+			struct Kernels
+			{
+				const char* (*find)(const char*, const char*, char);
+				size_t (*count)(const char*, const char*, char);
+				char* (*removeWhiteSpace)(char*, char*);
+			};
+
+			// Same set as std::isspace() in the classic locale.
+			inline bool isWhiteSpace(char character)
+			{
+				return character == ' ' || static_cast<unsigned char>(character - '\t') <= '\r' - '\t';
+			}
+
+			const char* findScalar(const char* begin, const char* end, char byte)
+			{
+				for (; begin != end; begin++)
+				{
+					if (*begin == byte)
+						return begin;
+				}
+
+				return end;
+			}
+
+			size_t countScalar(const char* begin, const char* end, char byte)
+			{
+				size_t count = 0;
+				for (; begin != end; begin++)
+					count += *begin == byte;
+
+				return count;
+			}
+
+			char* removeWhiteSpaceScalar(char* begin, char* end)
+			{
+				auto output = begin;
+				for (; begin != end; begin++)
+				{
+					*output = *begin;
+					output += !isWhiteSpace(*begin);
+				}
+
+				return output;
+			}
+
+#ifdef ARAP_SCAN_X86
+			__attribute__((target("sse2")))
+			const char* findSse2(const char* begin, const char* end, char byte)
+			{
+				auto needle = _mm_set1_epi8(byte);
+				for (; end - begin >= 16; begin += 16)
+				{
+					auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+					auto mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+					if (mask != 0)
+						return begin + __builtin_ctz(mask);
+				}
+
+				return findScalar(begin, end, byte);
+			}
+
+			// Plain SSE2, x86-64 CPUs without POPCNT take this path. The matches are summed per byte lane,
+			// which are folded by _mm_sad_epu8() before any of them can reach 256.
+			__attribute__((target("sse2")))
+			size_t countSse2(const char* begin, const char* end, char byte)
+			{
+				auto needle = _mm_set1_epi8(byte);
+				size_t count = 0;
+				while (end - begin >= 16)
+				{
+					auto lanes = _mm_setzero_si128();
+					for (int i = 0; i < 255 && end - begin >= 16; i++, begin += 16)
+					{
+						auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+						lanes = _mm_sub_epi8(lanes, _mm_cmpeq_epi8(block, needle));
+					}
+
+					auto sums = _mm_sad_epu8(lanes, _mm_setzero_si128());
+					count += static_cast<size_t>(_mm_cvtsi128_si32(sums)) + static_cast<size_t>(_mm_extract_epi16(sums, 4));
+				}
+
+				return count + countScalar(begin, end, byte);
+			}
+
+			__attribute__((target("avx2")))
+			const char* findAvx2(const char* begin, const char* end, char byte)
+			{
+				auto needle = _mm256_set1_epi8(byte);
+				for (; end - begin >= 32; begin += 32)
+				{
+					auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+					auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+					if (mask != 0)
+						return begin + __builtin_ctz(mask);
+				}
+
+				return findSse2(begin, end, byte);
+			}
+
+			__attribute__((target("avx2,popcnt")))
+			size_t countAvx2(const char* begin, const char* end, char byte)
+			{
+				auto needle = _mm256_set1_epi8(byte);
+				size_t count = 0;
+				for (; end - begin >= 32; begin += 32)
+				{
+					auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+					count += __builtin_popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle))));
+				}
+
+				return count + countSse2(begin, end, byte);
+			}
+
+			// Masked loads cover the tail, the bytes outside of the mask are not touched.
+			__attribute__((target("avx512f,avx512bw")))
+			const char* findAvx512(const char* begin, const char* end, char byte)
+			{
+				auto needle = _mm512_set1_epi8(byte);
+				while (begin != end)
+				{
+					auto length = end - begin;
+					__mmask64 valid = length >= 64 ? ~__mmask64(0) : (__mmask64(1) << length) - 1;
+					auto block = _mm512_maskz_loadu_epi8(valid, begin);
+					auto mask = _mm512_mask_cmpeq_epi8_mask(valid, block, needle);
+					if (mask != 0)
+						return begin + __builtin_ctzll(mask);
+
+					begin += length >= 64 ? 64 : length;
+				}
+
+				return end;
+			}
+
+			__attribute__((target("avx512f,avx512bw,popcnt")))
+			size_t countAvx512(const char* begin, const char* end, char byte)
+			{
+				auto needle = _mm512_set1_epi8(byte);
+				size_t count = 0;
+				while (begin != end)
+				{
+					auto length = end - begin;
+					__mmask64 valid = length >= 64 ? ~__mmask64(0) : (__mmask64(1) << length) - 1;
+					auto block = _mm512_maskz_loadu_epi8(valid, begin);
+					count += __builtin_popcountll(_mm512_mask_cmpeq_epi8_mask(valid, block, needle));
+
+					begin += length >= 64 ? 64 : length;
+				}
+
+				return count;
+			}
+
+			// Shuffle controls gathering the bytes of an 8 byte half not flagged by the mask to its front.
+			struct CompactionTable
+			{
+				uint64_t controls[256];
+				// Count of the bytes kept, so the kernel needs no POPCNT.
+				uint8_t kept[256];
+
+				CompactionTable()
+				{
+					for (uint32_t mask = 0; mask < 256; mask++)
+					{
+						uint64_t control = 0;
+						uint32_t keptCount = 0;
+						for (uint32_t i = 0; i < 8; i++)
+						{
+							if ((mask & (1 << i)) == 0)
+								control |= uint64_t(i) << (8 * keptCount++);
+						}
+
+						controls[mask] = control;
+						kept[mask] = static_cast<uint8_t>(keptCount);
+					}
+				}
+			};
+
+			__attribute__((target("sse2")))
+			inline __m128i whiteSpaceMask(__m128i block)
+			{
+				auto controlCharacters = _mm_sub_epi8(block, _mm_set1_epi8('\t'));
+				auto isControl = _mm_cmpeq_epi8(_mm_min_epu8(controlCharacters, _mm_set1_epi8('\r' - '\t')), controlCharacters);
+
+				return _mm_or_si128(isControl, _mm_cmpeq_epi8(block, _mm_set1_epi8(' ')));
+			}
+
+			// Every 16 byte block is compacted by two byte shuffles. The stores stay within the block
+			// already loaded, so the compaction works in place.
+			__attribute__((target("ssse3")))
+			char* removeWhiteSpaceSsse3(char* begin, char* end)
+			{
+				static const CompactionTable table;
+
+				auto output = begin;
+				for (; end - begin >= 16; begin += 16)
+				{
+					auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+					auto mask = static_cast<uint32_t>(_mm_movemask_epi8(whiteSpaceMask(block)));
+
+					auto low = mask & 0xff;
+					auto high = mask >> 8;
+					auto lowControl = _mm_cvtsi64_si128(static_cast<long long>(table.controls[low]));
+					auto highControl = _mm_cvtsi64_si128(static_cast<long long>(table.controls[high]));
+
+					_mm_storel_epi64(reinterpret_cast<__m128i*>(output), _mm_shuffle_epi8(block, lowControl));
+					output += table.kept[low];
+					_mm_storel_epi64(reinterpret_cast<__m128i*>(output), _mm_shuffle_epi8(_mm_srli_si128(block, 8), highControl));
+					output += table.kept[high];
+				}
+
+				auto tail = removeWhiteSpaceScalar(begin, end);
+				return std::copy(begin, tail, output);
+			}
+
+			// VBMI2 compresses the whole 64 byte block at once.
+			__attribute__((target("avx512f,avx512bw,avx512vbmi2,popcnt")))
+			char* removeWhiteSpaceVbmi2(char* begin, char* end)
+			{
+				auto output = begin;
+				auto space = _mm512_set1_epi8(' ');
+				auto tab = _mm512_set1_epi8('\t');
+				auto controlRange = _mm512_set1_epi8('\r' - '\t');
+
+				while (begin != end)
+				{
+					auto length = end - begin;
+					__mmask64 valid = length >= 64 ? ~__mmask64(0) : (__mmask64(1) << length) - 1;
+					auto block = _mm512_maskz_loadu_epi8(valid, begin);
+					auto whiteSpace = _mm512_cmpeq_epi8_mask(block, space) | _mm512_cmple_epu8_mask(_mm512_sub_epi8(block, tab), controlRange);
+					auto kept = valid & ~whiteSpace;
+
+					auto keptCount = __builtin_popcountll(kept);
+					__mmask64 store = keptCount == 64 ? ~__mmask64(0) : (__mmask64(1) << keptCount) - 1;
+					_mm512_mask_storeu_epi8(output, store, _mm512_maskz_compress_epi8(kept, block));
+
+					output += keptCount;
+					begin += length >= 64 ? 64 : length;
+				}
+
+				return output;
+			}
+
+			char* removeWhiteSpaceAvx512(char* begin, char* end)
+			{
+				static const bool vbmi2 = __builtin_cpu_supports("avx512vbmi2");
+				return vbmi2 ? removeWhiteSpaceVbmi2(begin, end) : removeWhiteSpaceSsse3(begin, end);
+			}
+#endif
+
+			// Indexed by Scanner::Kernel, constant initialized so usable from the static constructors.
+			const Kernels kernels[] = {
+				{findScalar, countScalar, removeWhiteSpaceScalar},
+#ifdef ARAP_SCAN_X86
+				{findSse2, countSse2, removeWhiteSpaceScalar},
+				{findAvx2, countAvx2, removeWhiteSpaceSsse3},
+				{findAvx512, countAvx512, removeWhiteSpaceAvx512}
+#endif
+			};
+
+			Scanner::Kernel detectKernel()
+			{
+				// Might run from a static constructor before the one of libgcc.
+#ifdef ARAP_SCAN_X86
+				__builtin_cpu_init();
+#endif
+				if (Scanner::isSupported(Scanner::Kernel::avx512))
+					return Scanner::Kernel::avx512;
+				if (Scanner::isSupported(Scanner::Kernel::avx2))
+					return Scanner::Kernel::avx2;
+				if (Scanner::isSupported(Scanner::Kernel::sse2))
+					return Scanner::Kernel::sse2;
+
+				return Scanner::Kernel::scalar;
+			}
+
+			std::atomic<Scanner::Kernel>& selectedKernel()
+			{
+				static std::atomic<Scanner::Kernel> kernel(detectKernel());
+				return kernel;
+			}
+		}
+
+		const char* Scanner::find(const char* begin, const char* end, char byte)
+		{
+			return kernels[static_cast<int>(selectedKernel().load(std::memory_order_relaxed))].find(begin, end, byte);
+		}
+
+		size_t Scanner::count(const char* begin, const char* end, char byte)
+		{
+			return kernels[static_cast<int>(selectedKernel().load(std::memory_order_relaxed))].count(begin, end, byte);
+		}
+
+		char* Scanner::removeWhiteSpace(char* begin, char* end)
+		{
+			return kernels[static_cast<int>(selectedKernel().load(std::memory_order_relaxed))].removeWhiteSpace(begin, end);
+		}
+
+		Scanner::Kernel Scanner::getKernel()
+		{
+			return selectedKernel().load();
+		}
+
+		bool Scanner::isSupported(Kernel kernel)
+		{
+			switch (kernel)
+			{
+			case Kernel::scalar:
+				return true;
+#ifdef ARAP_SCAN_X86
+			case Kernel::sse2:
+				return __builtin_cpu_supports("sse2");
+			case Kernel::avx2:
+				return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("popcnt");
+			case Kernel::avx512:
+				return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("popcnt");
+#endif
+			default:
+				return false;
+			}
+		}
+
+		void Scanner::setKernel(Kernel kernel)
+		{
+			if (!isSupported(kernel))
+				throw std::runtime_error("Scanner kernel " + std::to_string(static_cast<int>(kernel)) + " is not supported by the CPU.");
+
+			selectedKernel().store(kernel);
+		}
+	}
+}
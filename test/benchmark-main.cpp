@@ -0,0 +1,23 @@
+#include <cstring>
+#include <iostream>
+
+#include "benchmark.h"
+
+int main(int argc, char *argv[])
+{
+	std::cout << "Running arap-utils benchmarks" << std::endl;
+
+	// Optional argument filters the cases by a substring of their name.
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+
+	for (auto& benchmarkCase : benchmark::registry())
+	{
+		if (filter != nullptr && std::strstr(benchmarkCase.name.c_str(), filter) == nullptr)
+			continue;
+
+		std::cout << "[ RUN      ] " << benchmarkCase.name << std::endl;
+		benchmarkCase.function();
+	}
+
+	return 0;
+}
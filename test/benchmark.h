@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Minimal benchmark registry for the arap-utils-bench runner.
+namespace benchmark
+{
+	struct Case
+	{
+		std::string name;
+		void (*function)();
+	};
+
+	inline std::vector<Case>& registry()
+	{
+		static std::vector<Case> cases;
+		return cases;
+	}
+
+	struct Registration
+	{
+		Registration(const char* name, void (*function)())
+		{
+			registry().push_back({name, function});
+		}
+	};
+
+	class Stopwatch
+	{
+	public:
+		Stopwatch() : m_start(std::chrono::steady_clock::now())
+		{}
+
+		void restart() { m_start = std::chrono::steady_clock::now(); }
+
+		double nanoseconds() const
+		{
+			return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - m_start).count();
+		}
+
+		double seconds() const { return nanoseconds() / 1e9; }
+	private:
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+	inline void report(const std::string& label, double value, const std::string& unit)
+	{
+		std::printf("  %-56s %14.2f %s\n", label.c_str(), value, unit.c_str());
+		std::fflush(stdout);
+	}
+
+	// Keeps the optimizer from discarding the measured results.
+	template <typename T>
+	inline void doNotOptimize(const T& value)
+	{
+		asm volatile("" : : "r,m"(value) : "memory");
+	}
+}
+
+#define BENCHMARK(group, name) \
+	static void group##_##name##_benchmark(); \
+	static benchmark::Registration group##_##name##_registration(#group "." #name, group##_##name##_benchmark); \
+	static void group##_##name##_benchmark()
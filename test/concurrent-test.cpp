@@ -0,0 +1,138 @@
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "ArapConcurrent.h"
+
+TEST(MpscQueue, CapacityAndOrder)
+{
+	arap::concurrent::MpscQueue<int> queue(3);
+	ASSERT_EQ(4, queue.capacity());
+	ASSERT_TRUE(queue.empty());
+
+	for (int i = 0; i < 4; i++)
+		ASSERT_TRUE(queue.tryPush(i));
+	ASSERT_FALSE(queue.tryPush(4));
+
+	int value;
+	for (int i = 0; i < 4; i++)
+	{
+		ASSERT_TRUE(queue.tryPop(value));
+		ASSERT_EQ(i, value);
+	}
+
+	ASSERT_FALSE(queue.tryPop(value));
+	ASSERT_TRUE(queue.empty());
+}
+
+TEST(MpscQueue, ManyProducers)
+{
+	const uint32_t producerCount = 4;
+	const uint32_t perProducer = 100000;
+	arap::concurrent::MpscQueue<uint64_t> queue(1024);
+
+	std::vector<std::thread> producers;
+	for (uint32_t producer = 0; producer < producerCount; producer++)
+	{
+		producers.emplace_back([&queue, producer]()
+		{
+			for (uint64_t i = 0; i < perProducer; i++)
+			{
+				while (!queue.tryPush((static_cast<uint64_t>(producer) << 32) | i))
+					std::this_thread::yield();
+			}
+		});
+	}
+
+	std::vector<uint64_t> nextExpected(producerCount, 0);
+	uint64_t value;
+	for (uint64_t received = 0; received < producerCount * perProducer; (void)0)
+	{
+		if (!queue.tryPop(value))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		auto producer = value >> 32;
+		ASSERT_EQ(nextExpected[producer], value & 0xFFFFFFFF);
+		nextExpected[producer]++;
+		received++;
+	}
+
+	for (auto& thread : producers)
+		thread.join();
+}
+
+TEST(ThreadPool, RunsEveryJob)
+{
+	arap::concurrent::ThreadPool pool(3);
+	ASSERT_EQ(3, pool.size());
+
+	std::atomic<int> sum(0);
+	for (int i = 1; i <= 100; i++)
+		pool.submit([&sum, i]() { sum += i; });
+
+	pool.wait();
+	ASSERT_EQ(5050, sum);
+}
+
+TEST(ThreadPool, WaitRethrows)
+{
+	arap::concurrent::ThreadPool pool(2);
+	std::atomic<int> finished(0);
+
+	pool.submit([]() { throw std::runtime_error("job failed"); });
+	for (int i = 0; i < 10; i++)
+		pool.submit([&finished]() { finished++; });
+
+	ASSERT_THROW(pool.wait(), std::runtime_error);
+	ASSERT_EQ(10, finished);
+	ASSERT_NO_THROW(pool.wait());
+}
+
+TEST(ThreadPool, GroupWaitsOnlyForItsJobs)
+{
+	arap::concurrent::ThreadPool pool(1);
+	std::atomic<bool> release(false);
+	pool.submit([&release]()
+		{
+			while (!release)
+				std::this_thread::yield();
+		});
+
+	// The only worker is busy, the jobs of the group run on the waiting thread.
+	std::atomic<int> sum(0);
+	{
+		arap::concurrent::ThreadPool::Group group(pool);
+		for (int i = 1; i <= 10; i++)
+			group.submit([&sum, i]() { sum += i; });
+
+		group.submit([]() { throw std::runtime_error("job failed"); });
+		ASSERT_THROW(group.wait(), std::runtime_error);
+	}
+	ASSERT_EQ(55, sum);
+
+	release = true;
+	ASSERT_NO_THROW(pool.wait());
+}
+
+TEST(ThreadPool, GroupWaitInsideJob)
+{
+	arap::concurrent::ThreadPool pool(1);
+	std::atomic<int> sum(0);
+	pool.submit([&pool, &sum]()
+		{
+			arap::concurrent::ThreadPool::Group group(pool);
+			for (int i = 1; i <= 100; i++)
+				group.submit([&sum, i]() { sum += i; });
+
+			group.wait();
+		});
+
+	pool.wait();
+	ASSERT_EQ(5050, sum);
+}
@@ -0,0 +1,140 @@
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "ArapCoroutines.h"
+
+namespace
+{
+	arap::coroutines::Task sleepingSession(uint32_t& wakeUps)
+	{
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			co_await arap::coroutines::sleepFor(std::chrono::milliseconds(10));
+			wakeUps++;
+		}
+	}
+
+	arap::coroutines::Task receivingSession(arap::network::UdpListener& listener, std::chrono::milliseconds timeout,
+		std::vector<std::vector<uint8_t>>& received, uint32_t& timeouts)
+	{
+		auto packet = co_await arap::coroutines::receive(listener, std::chrono::steady_clock::now() + timeout);
+		if (packet)
+			received.push_back(*packet);
+		else
+			timeouts++;
+	}
+
+	arap::coroutines::Task sendingSession(arap::network::UdpSender& sender)
+	{
+		co_await arap::coroutines::sleepFor(std::chrono::milliseconds(20));
+		sender.sendData({1, 2, 3});
+	}
+
+	arap::coroutines::Task failingSession()
+	{
+		co_await arap::coroutines::sleepFor(std::chrono::milliseconds(1));
+		throw std::runtime_error("Session failed.");
+	}
+}
+
+TEST(Coroutines, ThousandsOfSleepingSessions)
+{
+	arap::coroutines::Scheduler scheduler;
+	uint32_t wakeUps = 0;
+
+	for (uint32_t i = 0; i < 5000; i++)
+		scheduler.spawn(sleepingSession(wakeUps));
+
+	arap::MonotonicTimer measure(std::chrono::milliseconds(30));
+	scheduler.run();
+
+	ASSERT_EQ(15000, wakeUps);
+	ASSERT_TRUE(measure.expired());
+	ASSERT_EQ(0, scheduler.size());
+}
+
+TEST(Coroutines, ReceiveWithDeadline)
+{
+	arap::network::UdpListener listener("::1", 40123);
+	arap::network::UdpSender sender("::1", 40123);
+	arap::coroutines::Scheduler scheduler;
+	std::vector<std::vector<uint8_t>> received;
+	uint32_t timeouts = 0;
+
+	scheduler.spawn(receivingSession(listener, std::chrono::milliseconds(1000), received, timeouts));
+	scheduler.spawn(sendingSession(sender));
+	scheduler.run();
+
+	ASSERT_EQ(1, received.size());
+	ASSERT_EQ(std::vector<uint8_t>({1, 2, 3}), received.front());
+	ASSERT_EQ(0, timeouts);
+
+	scheduler.spawn(receivingSession(listener, std::chrono::milliseconds(20), received, timeouts));
+	scheduler.run();
+	ASSERT_EQ(1, received.size());
+	ASSERT_EQ(1, timeouts);
+}
+
+TEST(Coroutines, ExceptionEndsRun)
+{
+	arap::coroutines::Scheduler scheduler;
+	uint32_t wakeUps = 0;
+
+	scheduler.spawn(failingSession());
+	scheduler.spawn(sleepingSession(wakeUps));
+
+	ASSERT_THROW(scheduler.run(), std::runtime_error);
+	ASSERT_EQ(1, scheduler.size());
+}
+
+namespace
+{
+	void spin(std::chrono::milliseconds duration)
+	{
+		auto until = std::chrono::steady_clock::now() + duration;
+		while (std::chrono::steady_clock::now() < until)
+		{}
+	}
+
+	arap::coroutines::Task busySession(bool& done)
+	{
+		while (!done)
+		{
+			spin(std::chrono::milliseconds(2));
+			co_await arap::coroutines::sleepFor(std::chrono::microseconds(100));
+		}
+	}
+
+	// Works for a while before every sleep, the sleep has to be counted from its start.
+	arap::coroutines::Task measuringSession(std::vector<std::chrono::nanoseconds>& elapsed, bool& done)
+	{
+		for (int i = 0; i < 10; i++)
+		{
+			spin(std::chrono::milliseconds(5));
+			auto start = std::chrono::steady_clock::now();
+			co_await arap::coroutines::sleepFor(std::chrono::milliseconds(6));
+			elapsed.push_back(std::chrono::steady_clock::now() - start);
+		}
+
+		done = true;
+	}
+}
+
+TEST(Coroutines, SleepNotShortenedByBusyTasks)
+{
+	arap::coroutines::Scheduler scheduler;
+	std::vector<std::chrono::nanoseconds> elapsed;
+	bool done = false;
+
+	// The busy one runs ahead of the measuring one in every pass.
+	scheduler.spawn(busySession(done));
+	scheduler.spawn(measuringSession(elapsed, done));
+	scheduler.run();
+
+	ASSERT_EQ(10, elapsed.size());
+	for (auto duration : elapsed)
+		ASSERT_GE(duration, std::chrono::milliseconds(6));
+}
@@ -0,0 +1,117 @@
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "benchmark.h"
+
+#include "ArapHash.h"
+
+namespace
+{
+	const size_t keyCount = 1000000;
+	const size_t rounds = 10;
+}
+
+// Hash table sized keys, the cost per call dominates.
+BENCHMARK(Hash, ShortKeys)
+{
+	std::mt19937_64 random(1);
+	std::vector<std::array<uint8_t, 8>> eui64s(keyCount);
+	std::vector<std::array<uint8_t, 16>> keys16(keyCount);
+	std::vector<std::string> texts(keyCount);
+	for (size_t i = 0; i < keyCount; i++)
+	{
+		auto value = random();
+		std::memcpy(eui64s[i].data(), &value, 8);
+		std::memcpy(keys16[i].data(), &value, 8);
+		std::memcpy(keys16[i].data() + 8, &value, 8);
+		texts[i] = "device" + std::to_string(value % 100000);
+	}
+
+	uint64_t sum = 0;
+	benchmark::Stopwatch stopwatch;
+	for (size_t round = 0; round < rounds; round++)
+	{
+		for (auto& key : eui64s)
+			sum += std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char*>(key.data()), key.size()));
+	}
+	benchmark::report("std::hash<string_view> 8 bytes", stopwatch.nanoseconds() / (keyCount * rounds), "ns/key");
+
+	stopwatch.restart();
+	for (size_t round = 0; round < rounds; round++)
+	{
+		for (auto& key : eui64s)
+			sum += arap::Hash::bytes(key.data(), key.size());
+	}
+	benchmark::report("Hash::bytes() 8 bytes", stopwatch.nanoseconds() / (keyCount * rounds), "ns/key");
+
+	stopwatch.restart();
+	for (size_t round = 0; round < rounds; round++)
+	{
+		for (auto& key : eui64s)
+			sum += arap::Hash::fixed(key);
+	}
+	benchmark::report("Hash::fixed<8>()", stopwatch.nanoseconds() / (keyCount * rounds), "ns/key");
+
+	stopwatch.restart();
+	for (size_t round = 0; round < rounds; round++)
+	{
+		for (auto& key : keys16)
+			sum += arap::Hash::fixed(key);
+	}
+	benchmark::report("Hash::fixed<16>()", stopwatch.nanoseconds() / (keyCount * rounds), "ns/key");
+
+	stopwatch.restart();
+	for (size_t round = 0; round < rounds; round++)
+	{
+		for (auto& text : texts)
+			sum += std::hash<std::string>()(text);
+	}
+	benchmark::report("std::hash<string> device name", stopwatch.nanoseconds() / (keyCount * rounds), "ns/key");
+
+	stopwatch.restart();
+	for (size_t round = 0; round < rounds; round++)
+	{
+		for (auto& text : texts)
+			sum += arap::Hash::bytes(text);
+	}
+	benchmark::report("Hash::bytes() device name", stopwatch.nanoseconds() / (keyCount * rounds), "ns/key");
+
+	benchmark::doNotOptimize(sum);
+}
+
+// Long lines and buffers, the bytes per second dominate.
+BENCHMARK(Hash, Bulk)
+{
+	for (size_t size : {256, 4096, 1 << 20})
+	{
+		std::string data(size, 'x');
+		for (size_t i = 0; i < size; i++)
+			data[i] = static_cast<char>(i * 131 + 7);
+
+		const size_t repeats = (size_t(1) << 30) / size;
+		uint64_t sum = 0;
+		benchmark::Stopwatch stopwatch;
+		for (size_t i = 0; i < repeats; i++)
+		{
+			data[0] = static_cast<char>(i);
+			sum += std::hash<std::string>()(data);
+		}
+		benchmark::report("std::hash<string> " + std::to_string(size) + " bytes", size * repeats / stopwatch.seconds() / 1e9, "GB/s");
+
+		stopwatch.restart();
+		for (size_t i = 0; i < repeats; i++)
+		{
+			data[0] = static_cast<char>(i);
+			sum += arap::Hash::bytes(data);
+		}
+		benchmark::report("Hash::bytes() " + std::to_string(size) + " bytes", size * repeats / stopwatch.seconds() / 1e9, "GB/s");
+
+		benchmark::doNotOptimize(sum);
+	}
+}
@@ -0,0 +1,77 @@
+#include <array>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "ArapHash.h"
+
+// Test vectors of the wyhash reference implementation, seeded by the index.
+TEST(Hash, ReferenceVectors)
+{
+	const std::vector<std::pair<uint64_t, std::string>> vectors = {
+		{0x93228a4de0eec5a2ull, ""},
+		{0xc5bac3db178713c4ull, "a"},
+		{0xa97f2f7b1d9b3314ull, "abc"},
+		{0x786d1f1df3801df4ull, "message digest"},
+		{0xdca5a8138ad37c87ull, "abcdefghijklmnopqrstuvwxyz"},
+		{0xb9e734f117cfaf70ull, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789"},
+		{0x6cc5eab49a92d617ull, "12345678901234567890123456789012345678901234567890123456789012345678901234567890"}};
+
+	for (size_t i = 0; i < vectors.size(); i++)
+		ASSERT_EQ(vectors[i].first, arap::Hash::bytes(vectors[i].second, i));
+}
+
+TEST(Hash, OverloadsAgree)
+{
+	std::vector<uint8_t> data;
+	for (size_t i = 0; i < 32; i++)
+		data.push_back(static_cast<uint8_t>(i * 37 + 1));
+
+	std::string_view text(reinterpret_cast<const char*>(data.data()), data.size());
+	ASSERT_EQ(arap::Hash::bytes(text, 5), arap::Hash::bytes(data, 5));
+	ASSERT_EQ(arap::Hash::bytes(data.data(), 8), arap::Hash::fixed<8>(data.data()));
+	ASSERT_EQ(arap::Hash::bytes(data.data(), 16, 9), arap::Hash::fixed<16>(data.data(), 9));
+
+	uint64_t eui64 = 0x0004a30b001a2b3cull;
+	std::array<uint8_t, 8> bytes;
+	std::memcpy(bytes.data(), &eui64, 8);
+	ASSERT_EQ(arap::Hash::fixed(eui64), arap::Hash::fixed(bytes));
+	ASSERT_EQ(arap::Hash::bytes(&eui64, 8), arap::Hasher()(eui64));
+	ASSERT_NE(arap::Hash::fixed(eui64), arap::Hash::fixed(eui64, 1));
+}
+
+TEST(Hash, NoCollisionsOnSimilarKeys)
+{
+	std::unordered_set<uint64_t> values;
+	std::string text;
+	for (size_t i = 0; i < 200; i++)
+	{
+		ASSERT_TRUE(values.insert(arap::Hash::bytes(text)).second);
+		text += 'a';
+	}
+
+	// Single bit flips of an EUI-64 and of a 16 byte key.
+	for (int bit = 0; bit < 64; bit++)
+		ASSERT_TRUE(values.insert(arap::Hash::fixed(uint64_t(1) << bit)).second);
+
+	for (int bit = 0; bit < 128; bit++)
+	{
+		std::array<uint8_t, 16> key = {};
+		key[bit / 8] = static_cast<uint8_t>(1 << (bit % 8));
+		ASSERT_TRUE(values.insert(arap::Hash::fixed(key)).second);
+	}
+}
+
+TEST(Hash, TransparentHasher)
+{
+	std::unordered_map<std::string, int, arap::Hasher, std::equal_to<>> map;
+	map["tere"] = 1;
+	ASSERT_EQ(1, map.find(std::string_view("tere"))->second);
+	ASSERT_EQ(map.end(), map.find("maailm"));
+}
@@ -0,0 +1,115 @@
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <malloc.h>
+
+#include "benchmark.h"
+
+#include "ArapRecords.h"
+
+namespace
+{
+	const size_t rowCount = 10000000;
+
+	// Telemetry alike rows - device, counter, reading, time of day.
+	const std::string& rows()
+	{
+		static std::string text;
+		if (text.empty())
+		{
+			for (size_t i = 0; i < rowCount; i++)
+			{
+				text += std::to_string(i % 977) + "," + std::to_string(i * 7919 % 1000003) + "," + std::to_string(i % 1000) + "." + std::to_string(i % 10);
+				text += "," + arap::Tools::get24hFormated(i % 86400) + "\n";
+			}
+		}
+
+		return text;
+	}
+}
+
+BENCHMARK(Records, ParserVersusSplit)
+{
+	auto& text = rows();
+	auto begin = text.data();
+	auto end = begin + text.size();
+
+	benchmark::Stopwatch stopwatch;
+	uint64_t sum = 0;
+	for (arap::strings::MappedLines::Iterator line(begin, end), last; line != last; ++line)
+	{
+		auto fields = arap::strings::Utilities::split(std::string(*line), ",");
+		sum += std::stoul(fields.at(0)) + std::stoul(fields.at(1)) + static_cast<uint64_t>(std::stod(fields.at(2)));
+		sum += arap::Tools::getTime24h(fields.at(3));
+	}
+	benchmark::doNotOptimize(sum);
+	benchmark::report("split() + stoul()", stopwatch.nanoseconds() / rowCount, "ns/row");
+
+	arap::records::Parser<uint32_t, uint32_t, double, arap::records::Time24h> parser;
+	decltype(parser)::Record record;
+	uint64_t parsedSum = 0;
+	stopwatch.restart();
+	for (arap::strings::MappedLines::Iterator line(begin, end), last; line != last; ++line)
+	{
+		if (!parser.parse(*line, record))
+			throw std::runtime_error("Benchmark row failed to parse.");
+
+		parsedSum += std::get<0>(record) + std::get<1>(record) + static_cast<uint64_t>(std::get<2>(record)) + std::get<3>(record).seconds;
+	}
+	benchmark::doNotOptimize(parsedSum);
+	benchmark::report("records::Parser", stopwatch.nanoseconds() / rowCount, "ns/row");
+
+	if (sum != parsedSum)
+		throw std::runtime_error("records::Parser disagrees with split().");
+}
+
+// Per field vectors built by hand from getLines() and split() as the baseline.
+BENCHMARK(Records, ColumnarTable)
+{
+	const std::string path = "./bench-columns.txt";
+	const size_t lineCount = 2000000;
+
+	std::string content;
+	for (size_t i = 0; i < lineCount; i++)
+		content += std::to_string(i % 977) + "," + std::to_string(i * 7919 % 1000003) + "," + std::to_string(i % 1000) + ".5,device" + std::to_string(i % 50) + "\n";
+	arap::strings::Utilities::writeToFile(path, content);
+	content.clear();
+	content.shrink_to_fit();
+
+	auto heap = []() { auto information = mallinfo2(); return information.uordblks + information.hblkhd; };
+
+	auto before = heap();
+	benchmark::Stopwatch stopwatch;
+	auto fields = std::make_unique<std::vector<std::vector<std::string>>>();
+	for (auto& line : arap::strings::Utilities::getLines(path))
+		fields->push_back(arap::strings::Utilities::split(line, ","));
+	benchmark::report("getLines() + split() load", stopwatch.nanoseconds() / lineCount, "ns/line");
+	benchmark::report("vector<vector<string>> memory", static_cast<double>(heap() - before) / lineCount, "B/line");
+
+	stopwatch.restart();
+	double sum = 0;
+	for (auto& row : *fields)
+		sum += std::stod(row.at(2));
+	benchmark::doNotOptimize(sum);
+	benchmark::report("vector<vector<string>> column sum", stopwatch.nanoseconds() / lineCount, "ns/line");
+	fields.reset();
+
+	arap::concurrent::ThreadPool pool;
+	before = heap();
+	stopwatch.restart();
+	auto table = std::make_unique<arap::records::ColumnarTable<uint32_t, uint32_t, double, std::string_view>>(path, pool);
+	benchmark::report("ColumnarTable load", stopwatch.nanoseconds() / lineCount, "ns/line");
+	benchmark::report("ColumnarTable memory", static_cast<double>(heap() - before) / lineCount, "B/line");
+
+	stopwatch.restart();
+	sum = 0;
+	for (auto value : table->column<2>())
+		sum += value;
+	benchmark::doNotOptimize(sum);
+	benchmark::report("ColumnarTable column sum", stopwatch.nanoseconds() / lineCount, "ns/line");
+
+	std::remove(path.c_str());
+}
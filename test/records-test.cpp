@@ -0,0 +1,98 @@
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+#include "gtest/gtest.h"
+
+#include "ArapRecords.h"
+
+TEST(RecordParser, TypedFields)
+{
+	arap::records::Parser<uint32_t, int16_t, double, std::string_view, arap::records::Time24h> parser;
+
+	auto record = parser.parse("4000000000,-12,21.5,sensor 7,12:30:05");
+	ASSERT_EQ(4000000000u, std::get<0>(record));
+	ASSERT_EQ(-12, std::get<1>(record));
+	ASSERT_DOUBLE_EQ(21.5, std::get<2>(record));
+	ASSERT_EQ("sensor 7", std::get<3>(record));
+	ASSERT_EQ(12 * 3600 + 30 * 60 + 5, std::get<4>(record).seconds);
+
+	decltype(parser)::Record reused;
+	ASSERT_TRUE(parser.parse("1,2,3,,00:00:00", reused));
+	ASSERT_TRUE(std::get<3>(reused).empty());
+	ASSERT_EQ(0, std::get<4>(reused).seconds);
+
+	ASSERT_FALSE(parser.parse("1,2,3,x", reused));
+	ASSERT_FALSE(parser.parse("1,2,3,x,00:00:00,", reused));
+	ASSERT_FALSE(parser.parse("1,70000,3,x,00:00:00", reused));
+	ASSERT_FALSE(parser.parse("1,2,3.0abc,x,00:00:00", reused));
+	ASSERT_FALSE(parser.parse(",2,3,x,00:00:00", reused));
+	ASSERT_FALSE(parser.parse("-1,2,3,x,00:00:00", reused));
+	ASSERT_THROW(parser.parse("1,2,three,x,00:00:00"), std::runtime_error);
+}
+
+TEST(RecordParser, Quoting)
+{
+	arap::records::Parser<std::string_view, uint32_t, std::string_view> parser(';');
+
+	auto record = parser.parse("\"a;b\";\"42\";\"say \"\"hi\"\"\"");
+	ASSERT_EQ("a;b", std::get<0>(record));
+	ASSERT_EQ(42, std::get<1>(record));
+	ASSERT_EQ("say \"\"hi\"\"", std::get<2>(record));
+
+	decltype(parser)::Record reused;
+	ASSERT_FALSE(parser.parse("\"open;1;x", reused));
+	ASSERT_FALSE(parser.parse("\"a\"b;1;x", reused));
+	ASSERT_TRUE(parser.parse("\"\";1;\"\"", reused));
+}
+
+TEST(RecordParser, Time24hRules)
+{
+	arap::records::Time24h time;
+	ASSERT_TRUE(arap::records::Time24h::parse("23:59:59", time));
+	ASSERT_EQ(arap::Tools::getTime24h(std::string("23:59:59")), time.seconds);
+	ASSERT_TRUE(arap::records::Time24h::parse("7:5:00", time));
+	ASSERT_EQ(arap::Tools::getTime24h(std::string("7:5:00")), time.seconds);
+
+	ASSERT_FALSE(arap::records::Time24h::parse("24:00:00", time));
+	ASSERT_FALSE(arap::records::Time24h::parse("12:60:00", time));
+	ASSERT_FALSE(arap::records::Time24h::parse("12:00:0", time));
+	ASSERT_FALSE(arap::records::Time24h::parse("12:00", time));
+	ASSERT_FALSE(arap::records::Time24h::parse("12:00:00:00", time));
+	ASSERT_FALSE(arap::records::Time24h::parse("", time));
+}
+
+TEST(ColumnarTable, LoadsColumnsInOrder)
+{
+	const std::string path = "./test-columns.txt";
+	std::string content;
+	for (uint32_t i = 0; i < 10000; i++)
+	{
+		content += std::to_string(i) + "," + std::to_string(i / 4.0) + ",device" + std::to_string(i % 7) + "\n";
+		if (i % 1000 == 0)
+			content += "broken line\n\n";
+	}
+	arap::strings::Utilities::writeToFile(path, content);
+
+	arap::concurrent::ThreadPool pool(3);
+	arap::records::ColumnarTable<uint32_t, double, std::string_view> table(path, pool);
+	ASSERT_EQ(10000, table.size());
+	ASSERT_EQ(10, table.getRejectedLines());
+
+	for (uint32_t i = 0; i < 10000; i++)
+	{
+		ASSERT_EQ(i, table.column<0>()[i]);
+		ASSERT_DOUBLE_EQ(i / 4.0, table.column<1>()[i]);
+		ASSERT_EQ("device" + std::to_string(i % 7), table.column<2>()[i]);
+	}
+
+	arap::records::ColumnarTable<uint32_t> semicolons(path, pool, arap::records::Parser<uint32_t>(';'));
+	ASSERT_EQ(0, semicolons.size());
+	ASSERT_EQ(10010, semicolons.getRejectedLines());
+
+	ASSERT_THROW((arap::records::ColumnarTable<uint32_t>("/hullumaja/tere.txt", pool)), std::runtime_error);
+	std::remove(path.c_str());
+}
@@ -0,0 +1,554 @@
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <locale>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <malloc.h>
+
+#include "benchmark.h"
+
+#include "ArapUtils.h"
+
+namespace
+{
+	const std::string logPath = "./bench-log.txt";
+	const size_t logLines = 2000000;
+
+	// Log alike content of varying line lengths, written once per run.
+	const std::string& logFile()
+	{
+		static bool written = false;
+		if (!written)
+		{
+			std::string content;
+			for (size_t i = 0; i < logLines; i++)
+				content += "2024-01-01 12:00:00 device " + std::to_string(i % 977) + " reported value " + std::to_string(i * 7919 % 100003) + "\n";
+
+			arap::strings::Utilities::writeToFile(logPath, content);
+			written = true;
+		}
+
+		return logPath;
+	}
+
+	double megabytes(const std::string& path)
+	{
+		struct stat status;
+		stat(path.c_str(), &status);
+		return status.st_size / 1e6;
+	}
+}
+
+BENCHMARK(Strings, GetLinesFile)
+{
+	auto& path = logFile();
+
+	benchmark::Stopwatch stopwatch;
+	auto lines = arap::strings::Utilities::getLines(path);
+	auto seconds = stopwatch.seconds();
+
+	benchmark::doNotOptimize(lines.size());
+	benchmark::report("getLines path", megabytes(path) / seconds, "MB/s");
+}
+
+BENCHMARK(Strings, MappedLines)
+{
+	auto& path = logFile();
+
+	benchmark::Stopwatch stopwatch;
+	arap::strings::MappedLines mapped(path);
+	size_t count = 0;
+	size_t characters = 0;
+	for (auto line : mapped)
+	{
+		count++;
+		characters += line.size();
+	}
+	auto seconds = stopwatch.seconds();
+
+	benchmark::doNotOptimize(count + characters);
+	benchmark::report("MappedLines iteration", megabytes(path) / seconds, "MB/s");
+
+	stopwatch.restart();
+	auto lines = mapped.getLines();
+	seconds = stopwatch.seconds();
+
+	benchmark::doNotOptimize(lines.size());
+	benchmark::report("MappedLines getLines()", megabytes(path) / seconds, "MB/s");
+}
+
+BENCHMARK(Strings, LineReader)
+{
+	auto& path = logFile();
+
+	benchmark::Stopwatch stopwatch;
+	arap::strings::LineReader reader(path);
+	size_t count = 0;
+	size_t characters = 0;
+	for (auto line : reader)
+	{
+		count++;
+		characters += line.size();
+	}
+	auto seconds = stopwatch.seconds();
+
+	benchmark::doNotOptimize(count + characters);
+	benchmark::report("LineReader path", megabytes(path) / seconds, "MB/s");
+}
+
+// Synthetic in-memory data, average line of 64 bytes.
+BENCHMARK(Strings, ScannerKernels)
+{
+	const size_t size = 256 * 1024 * 1024;
+	std::vector<char> data(size);
+	std::mt19937 random(size);
+	for (auto& byte : data)
+		byte = random() % 64 == 0 ? '\n' : 'a' + random() % 26;
+
+	auto begin = data.data();
+	auto end = begin + size;
+	const double gigabytes = size / 1e9;
+
+	benchmark::Stopwatch stopwatch;
+	size_t found = 0;
+	for (const char* position = begin; position != end; found++)
+	{
+		auto newline = static_cast<const char*>(std::memchr(position, '\n', end - position));
+		position = newline == nullptr ? end : newline + 1;
+	}
+	benchmark::doNotOptimize(found);
+	benchmark::report("memchr() line walk", gigabytes / stopwatch.seconds(), "GB/s");
+
+	auto detected = arap::strings::Scanner::getKernel();
+	const std::vector<std::pair<arap::strings::Scanner::Kernel, std::string>> kernels = {
+		{arap::strings::Scanner::Kernel::scalar, "scalar"},
+		{arap::strings::Scanner::Kernel::sse2, "sse2"},
+		{arap::strings::Scanner::Kernel::avx2, "avx2"},
+		{arap::strings::Scanner::Kernel::avx512, "avx512"}};
+
+	for (auto& kernel : kernels)
+	{
+		if (!arap::strings::Scanner::isSupported(kernel.first))
+			continue;
+
+		arap::strings::Scanner::setKernel(kernel.first);
+
+		stopwatch.restart();
+		found = 0;
+		for (const char* position = begin; position != end; found++)
+		{
+			auto newline = arap::strings::Scanner::find(position, end, '\n');
+			position = newline == end ? end : newline + 1;
+		}
+		benchmark::doNotOptimize(found);
+		benchmark::report(kernel.second + " find() line walk", gigabytes / stopwatch.seconds(), "GB/s");
+
+		stopwatch.restart();
+		benchmark::doNotOptimize(arap::strings::Scanner::count(begin, end, '\n'));
+		benchmark::report(kernel.second + " count()", gigabytes / stopwatch.seconds(), "GB/s");
+	}
+
+	arap::strings::Scanner::setKernel(detected);
+}
+
+BENCHMARK(Strings, Split)
+{
+	std::string record;
+	for (size_t i = 0; i < 64; i++)
+		record += "field" + std::to_string(i) + ";";
+
+	const size_t rounds = 100000;
+	benchmark::Stopwatch stopwatch;
+	size_t fields = 0;
+	for (size_t i = 0; i < rounds; i++)
+		fields += arap::strings::Utilities::split(record, ";").size();
+
+	benchmark::doNotOptimize(fields);
+	benchmark::report("split() 64 fields", stopwatch.nanoseconds() / rounds, "ns/record");
+
+	std::vector<std::string_view> tokens;
+	stopwatch.restart();
+	fields = 0;
+	for (size_t i = 0; i < rounds; i++)
+	{
+		tokens.clear();
+		fields += arap::strings::Tokenizer(record, ";").appendTo(tokens);
+	}
+
+	benchmark::doNotOptimize(fields);
+	benchmark::report("Tokenizer::appendTo() 64 fields", stopwatch.nanoseconds() / rounds, "ns/record");
+
+	const std::string multiRecord = "key1 := value1 := key2 := value2 := key3 := value3";
+	stopwatch.restart();
+	fields = 0;
+	for (size_t i = 0; i < rounds; i++)
+	{
+		for (auto token : arap::strings::Tokenizer(multiRecord, " := "))
+			fields += token.size();
+	}
+
+	benchmark::doNotOptimize(fields);
+	benchmark::report("Tokenizer 6 fields, 4 byte delimiter", stopwatch.nanoseconds() / rounds, "ns/record");
+}
+
+// Counting the lines of one device, scaling with the threads is bounded by the cores of the machine.
+BENCHMARK(Strings, ParallelLines)
+{
+	auto& path = logFile();
+	arap::strings::MappedLines mapped(path);
+	auto gigabytes = mapped.data().size() / 1e9;
+
+	auto matches = [](size_t& partial, std::string_view line) { partial += line.find("device 7 ") != std::string_view::npos; };
+	auto sum = [](size_t& total, size_t&& partial) { total += partial; };
+
+	benchmark::Stopwatch stopwatch;
+	size_t sequential = 0;
+	for (auto line : mapped)
+		matches(sequential, line);
+	benchmark::doNotOptimize(sequential);
+	benchmark::report("sequential", gigabytes / stopwatch.seconds(), "GB/s");
+
+	for (size_t threads : {1, 2, 4, 8})
+	{
+		arap::concurrent::ThreadPool pool(threads);
+
+		stopwatch.restart();
+		auto count = arap::strings::ParallelLines::mapReduce(pool, mapped.data(), size_t(0), matches, sum);
+		auto seconds = stopwatch.seconds();
+
+		if (count != sequential)
+			throw std::runtime_error("Parallel count differs from the sequential one.");
+
+		benchmark::report("mapReduce " + std::to_string(threads) + " threads", gigabytes / seconds, "GB/s");
+	}
+
+	benchmark::report("hardware threads", std::thread::hardware_concurrency(), "");
+}
+
+// Millions of short lines, the per line overhead dominates.
+BENCHMARK(Strings, LineTable)
+{
+	const std::string path = "./bench-short.txt";
+	const size_t lineCount = 5000000;
+	std::string content;
+	for (size_t i = 0; i < lineCount; i++)
+		content += "id=" + std::to_string(i * 7919 % 1000003) + "\n";
+	arap::strings::Utilities::writeToFile(path, content);
+	content.clear();
+	content.shrink_to_fit();
+
+	// Large blocks are mapped separately from the arena.
+	auto heap = []() { auto information = mallinfo2(); return information.uordblks + information.hblkhd; };
+
+	auto before = heap();
+	benchmark::Stopwatch stopwatch;
+	auto vectorLines = std::make_unique<std::vector<std::string>>(arap::strings::Utilities::getLines(path));
+	benchmark::report("vector<string> load", stopwatch.nanoseconds() / lineCount, "ns/line");
+	benchmark::report("vector<string> memory", static_cast<double>(heap() - before) / lineCount, "B/line");
+	stopwatch.restart();
+	vectorLines.reset();
+	benchmark::report("vector<string> destruction", stopwatch.nanoseconds() / lineCount, "ns/line");
+
+	before = heap();
+	stopwatch.restart();
+	auto table = std::make_unique<arap::strings::LineTable>();
+	arap::strings::Utilities::getLines(path, *table);
+	benchmark::report("LineTable load", stopwatch.nanoseconds() / lineCount, "ns/line");
+	benchmark::report("LineTable memory", static_cast<double>(heap() - before) / lineCount, "B/line");
+	stopwatch.restart();
+	table.reset();
+	benchmark::report("LineTable destruction", stopwatch.nanoseconds() / lineCount, "ns/line");
+
+	std::remove(path.c_str());
+}
+
+// Text with a space every few characters, the old locale based removal as the baseline.
+BENCHMARK(Strings, RemoveWhiteSpace)
+{
+	const size_t size = 64 * 1024 * 1024;
+	std::string text;
+	text.reserve(size);
+	std::mt19937 random(size);
+	while (text.size() < size)
+		text += random() % 6 == 0 ? (random() % 4 == 0 ? '\t' : ' ') : static_cast<char>('a' + random() % 26);
+
+	const double gigabytes = size / 1e9;
+
+	auto copy = text;
+	benchmark::Stopwatch stopwatch;
+	copy.erase(std::remove_if(copy.begin(), copy.end(),
+		std::bind(std::isspace<char>, std::placeholders::_1, std::locale::classic())), copy.end());
+	benchmark::doNotOptimize(copy.size());
+	benchmark::report("remove_if locale isspace", gigabytes / stopwatch.seconds(), "GB/s");
+
+	auto detected = arap::strings::Scanner::getKernel();
+	const std::vector<std::pair<arap::strings::Scanner::Kernel, std::string>> kernels = {
+		{arap::strings::Scanner::Kernel::scalar, "scalar"},
+		{arap::strings::Scanner::Kernel::avx2, "ssse3 shuffle"},
+		{arap::strings::Scanner::Kernel::avx512, "avx512 compress"}};
+
+	for (auto& kernel : kernels)
+	{
+		if (!arap::strings::Scanner::isSupported(kernel.first))
+			continue;
+
+		arap::strings::Scanner::setKernel(kernel.first);
+		copy = text;
+		stopwatch.restart();
+		arap::strings::Utilities::removeWhiteSpace(copy);
+		benchmark::doNotOptimize(copy.size());
+		benchmark::report("removeWhiteSpace() " + kernel.second, gigabytes / stopwatch.seconds(), "GB/s");
+	}
+
+	arap::strings::Scanner::setKernel(detected);
+}
+
+// Status lines appended one by one.
+BENCHMARK(Strings, FileAppender)
+{
+	const std::string path = "./bench-append.txt";
+	const std::string line = "2024-01-01 12:00:00 device 17 status ok\n";
+	const size_t count = 20000;
+
+	std::remove(path.c_str());
+	benchmark::Stopwatch stopwatch;
+	for (size_t i = 0; i < count; i++)
+		arap::strings::Utilities::writeToFile(path, line, false);
+	benchmark::report("writeToFile() append", stopwatch.nanoseconds() / count, "ns/line");
+
+	const std::vector<std::pair<arap::strings::FileAppender::Durability, std::string>> durabilities = {
+		{arap::strings::FileAppender::Durability::none, "none"},
+		{arap::strings::FileAppender::Durability::everyBytes, "fdatasync per 1 MB"},
+		{arap::strings::FileAppender::Durability::everyFlush, "fdatasync per flush"}};
+
+	for (auto& durability : durabilities)
+	{
+		auto policy = arap::strings::FileAppender::defaultPolicy();
+		policy.durability = durability.first;
+		policy.syncBytes = 1024 * 1024;
+
+		std::remove(path.c_str());
+		stopwatch.restart();
+		{
+			arap::strings::FileAppender appender(path, policy);
+			for (size_t i = 0; i < count; i++)
+				appender.append(line);
+		}
+		benchmark::report("FileAppender durability " + durability.second, stopwatch.nanoseconds() / count, "ns/line");
+	}
+
+	std::remove(path.c_str());
+}
+
+namespace
+{
+	void reportPercentiles(const std::string& label, std::vector<double>& latencies)
+	{
+		std::sort(latencies.begin(), latencies.end());
+		const std::vector<std::pair<double, std::string>> percentiles = {{0.5, "p50"}, {0.99, "p99"}, {0.999, "p99.9"}};
+		for (auto& percentile : percentiles)
+			benchmark::report(label + " " + percentile.second, latencies[static_cast<size_t>(percentile.first * (latencies.size() - 1))], "ns");
+		benchmark::report(label + " max", latencies.back(), "ns");
+	}
+}
+
+// Latency of the producer call only, the disk time is what the writer thread takes off it.
+BENCHMARK(Strings, AsyncWriterProducerLatency)
+{
+	const std::string path = "./bench-async.txt";
+	const std::string line = "2024-01-01 12:00:00 device 17 status ok\n";
+	const size_t synchronousCount = 20000;
+	const size_t producers = 2;
+	const size_t countPerProducer = 200000;
+
+	std::remove(path.c_str());
+	std::vector<double> latencies;
+	latencies.reserve(synchronousCount);
+	for (size_t i = 0; i < synchronousCount; i++)
+	{
+		benchmark::Stopwatch call;
+		arap::strings::Utilities::writeToFile(path, line, false);
+		latencies.push_back(call.nanoseconds());
+	}
+	reportPercentiles("writeToFile()", latencies);
+
+	for (auto durability : {arap::strings::FileAppender::Durability::none, arap::strings::FileAppender::Durability::everyFlush})
+	{
+		std::remove(path.c_str());
+		auto policy = arap::strings::FileAppender::defaultPolicy();
+		policy.durability = durability;
+		std::vector<std::vector<double>> perProducer(producers);
+
+		benchmark::Stopwatch stopwatch;
+		arap::strings::AsyncWriter writer({path}, policy, arap::strings::AsyncWriter::Overflow::wait, 16384);
+		std::vector<std::thread> threads;
+		for (size_t producer = 0; producer < producers; producer++)
+		{
+			threads.emplace_back([&writer, &perProducer, &line, producer, countPerProducer]()
+				{
+					auto& measured = perProducer[producer];
+					measured.reserve(countPerProducer);
+					for (size_t i = 0; i < countPerProducer; i++)
+					{
+						benchmark::Stopwatch call;
+						writer.write(0, line);
+						measured.push_back(call.nanoseconds());
+					}
+				});
+		}
+
+		for (auto& thread : threads)
+			thread.join();
+		writer.flush();
+		auto seconds = stopwatch.seconds();
+
+		latencies.clear();
+		for (auto& measured : perProducer)
+			latencies.insert(latencies.end(), measured.begin(), measured.end());
+
+		std::string label = durability == arap::strings::FileAppender::Durability::none ? "AsyncWriter" : "AsyncWriter fdatasync";
+		reportPercentiles(label, latencies);
+
+		auto statistics = writer.getStatistics();
+		benchmark::report(label + " throughput", producers * countPerProducer / seconds, "lines/s");
+		benchmark::report(label + " lines per commit", static_cast<double>(producers * countPerProducer) / statistics.commits, "");
+		benchmark::report(label + " backpressure events", statistics.backpressureEvents, "");
+	}
+
+	std::remove(path.c_str());
+}
+
+// Thousands of small files, e.g. a state file per device.
+BENCHMARK(Strings, BatchFileIo)
+{
+	const size_t count = 4000;
+	const std::string content = std::string(1000, 'x') + "\n";
+
+	std::vector<arap::linuxOS::BatchFileIo::WriteRequest> requests;
+	std::vector<std::string> paths;
+	for (size_t i = 0; i < count; i++)
+	{
+		paths.push_back("./bench-batch" + std::to_string(i) + ".txt");
+		requests.push_back({paths.back(), content});
+	}
+
+	benchmark::Stopwatch stopwatch;
+	for (auto& path : paths)
+		arap::strings::Utilities::writeToFile(path, content);
+	benchmark::report("writeToFile() per file", stopwatch.nanoseconds() / count, "ns/file");
+
+	stopwatch.restart();
+	size_t lines = 0;
+	for (auto& path : paths)
+		lines += arap::strings::Utilities::getLines(path).size();
+	benchmark::doNotOptimize(lines);
+	benchmark::report("getLines() per file", stopwatch.nanoseconds() / count, "ns/file");
+
+	const std::vector<std::pair<arap::linuxOS::BatchFileIo::Backend, std::string>> backends = {
+		{arap::linuxOS::BatchFileIo::Backend::ioUring, "io_uring"},
+		{arap::linuxOS::BatchFileIo::Backend::threadPool, "thread pool"}};
+
+	for (auto& backend : backends)
+	{
+		std::unique_ptr<arap::linuxOS::BatchFileIo> io;
+		try
+		{
+			io.reset(new arap::linuxOS::BatchFileIo(backend.first));
+		}
+		catch (const std::runtime_error&)
+		{
+			continue;
+		}
+
+		stopwatch.restart();
+		io->writeFiles(requests);
+		benchmark::report("BatchFileIo writeFiles() " + backend.second, stopwatch.nanoseconds() / count, "ns/file");
+
+		stopwatch.restart();
+		auto results = io->readFiles(paths);
+		benchmark::doNotOptimize(results.size());
+		benchmark::report("BatchFileIo readFiles() " + backend.second, stopwatch.nanoseconds() / count, "ns/file");
+	}
+
+	for (auto& path : paths)
+		std::remove(path.c_str());
+}
+
+// Histogram of the distinct words of the log.
+BENCHMARK(Strings, InternPool)
+{
+	auto& path = logFile();
+	arap::strings::MappedLines mapped(path);
+	size_t wordCount = 0;
+
+	benchmark::Stopwatch stopwatch;
+	std::unordered_map<std::string, size_t> counts;
+	std::vector<std::string> words;
+	for (auto line : mapped)
+	{
+		words.clear();
+		wordCount += arap::strings::Tokenizer(line, " ").appendTo(words);
+		for (auto& word : words)
+			counts[word]++;
+	}
+	benchmark::doNotOptimize(counts.size());
+	benchmark::report("unordered_map<string, size_t> histogram", stopwatch.nanoseconds() / wordCount, "ns/word");
+
+	stopwatch.restart();
+	arap::strings::InternPool pool;
+	std::vector<arap::strings::InternPool::Id> ids;
+	for (auto line : mapped)
+	{
+		ids.clear();
+		arap::strings::Tokenizer(line, " ").appendIdsTo(pool, ids);
+	}
+	benchmark::doNotOptimize(pool.size());
+	benchmark::report("InternPool histogram", stopwatch.nanoseconds() / wordCount, "ns/word");
+	benchmark::report("InternPool distinct words", pool.size(), "");
+	benchmark::report("InternPool memory", pool.getMemoryUsage() / 1e6, "MB");
+}
+
+// Polling a status file that grows by a few lines at a time.
+BENCHMARK(Strings, FileFollower)
+{
+	const std::string path = "./bench-follow.txt";
+	const std::string line = "2024-01-01 12:00:00 device 17 status ok\n";
+	const size_t rounds = 200;
+
+	std::string content;
+	for (size_t i = 0; i < 200000; i++)
+		content += line;
+	arap::strings::Utilities::writeToFile(path, content);
+
+	benchmark::Stopwatch stopwatch;
+	size_t lines = 0;
+	for (size_t i = 0; i < rounds; i++)
+	{
+		arap::strings::Utilities::writeToFile(path, line + line, false);
+		lines += arap::strings::Utilities::getLines(path).size();
+	}
+	benchmark::doNotOptimize(lines);
+	benchmark::report("getLines() re-read of " + std::to_string(static_cast<int>(megabytes(path))) + " MB", stopwatch.nanoseconds() / rounds, "ns/poll");
+
+	arap::strings::FileFollower follower(path);
+	std::vector<std::string> appended;
+	stopwatch.restart();
+	for (size_t i = 0; i < rounds; i++)
+	{
+		arap::strings::Utilities::writeToFile(path, line + line, false);
+		follower.read(appended);
+	}
+	benchmark::report("FileFollower read()", stopwatch.nanoseconds() / rounds, "ns/poll");
+
+	if (appended.size() != 2 * rounds)
+		throw std::runtime_error("FileFollower missed appended lines.");
+
+	std::remove(path.c_str());
+}
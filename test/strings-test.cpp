@@ -1,4 +1,14 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <locale>
+#include <random>
 #include <stdexcept>
+#include <thread>
+
+#include <sys/resource.h>
 
 #include "gtest/gtest.h"
 
@@ -34,5 +44,623 @@ TEST(StringOperations, FilesystemReadAndWrite)
 TEST(StringOperations, Split)
 {
 	ASSERT_EQ(3, arap::strings::Utilities::split("Jou mees tere.", " ").size());	
+	ASSERT_EQ((std::vector<std::string>{"", "a", "", "b"}), arap::strings::Utilities::split(",a,,b,", ","));
+	ASSERT_TRUE(arap::strings::Utilities::split("", ",").empty());
+	ASSERT_EQ((std::vector<std::string>{"a", "b<c", "", ""}), arap::strings::Utilities::split("a<>b<c<><><>", "<>"));
+	ASSERT_EQ((std::vector<std::string>{"abc"}), arap::strings::Utilities::split("abc", ""));
+}
+
+TEST(StringOperations, Tokenizer)
+{
+	std::vector<std::string_view> tokens;
+	ASSERT_EQ(4, arap::strings::Tokenizer("key := value :=  := x", " := ").appendTo(tokens));
+	ASSERT_EQ((std::vector<std::string_view>{"key", "value", "", "x"}), tokens);
+
+	// Appends, the earlier tokens stay.
+	ASSERT_EQ(1, arap::strings::Tokenizer("::", "::").appendTo(tokens));
+	ASSERT_EQ(5, tokens.size());
+	ASSERT_TRUE(tokens.back().empty());
+
+	std::string record = "1;22;333";
+	size_t total = 0;
+	for (auto token : arap::strings::Tokenizer(record, ";"))
+	{
+		ASSERT_GE(token.data(), record.data());
+		total += token.size();
+	}
+	ASSERT_EQ(6, total);
+
+	const char text[] = "abab";
+	ASSERT_EQ(text + 2, arap::strings::Tokenizer::find(text + 1, text + 4, "ab"));
+	ASSERT_EQ(text + 4, arap::strings::Tokenizer::find(text, text + 4, "bac"));
+}
+
+TEST(StringOperations, ScannerKernelsAgree)
+{
+	auto detected = arap::strings::Scanner::getKernel();
+	std::mt19937 random(7);
+	std::vector<char> data(16384);
+	for (auto& byte : data)
+		byte = random() % 8 == 0 ? '\n' : 'a' + random() % 26;
+
+	std::vector<arap::strings::Scanner::Kernel> kernels = {arap::strings::Scanner::Kernel::scalar, arap::strings::Scanner::Kernel::sse2,
+		arap::strings::Scanner::Kernel::avx2, arap::strings::Scanner::Kernel::avx512};
+
+	for (auto kernel : kernels)
+	{
+		if (!arap::strings::Scanner::isSupported(kernel))
+		{
+			ASSERT_THROW(arap::strings::Scanner::setKernel(kernel), std::runtime_error);
+			continue;
+		}
+
+		arap::strings::Scanner::setKernel(kernel);
+		for (size_t offset = 0; offset < 70; offset++)
+		{
+			for (size_t length : {0, 1, 15, 16, 17, 31, 33, 63, 64, 65, 200, 4000, 16000})
+			{
+				auto begin = data.data() + offset;
+				auto end = begin + length;
+				ASSERT_EQ(std::find(begin, end, '\n'), arap::strings::Scanner::find(begin, end, '\n'));
+				ASSERT_EQ(std::find(begin, end, '#'), arap::strings::Scanner::find(begin, end, '#'));
+				ASSERT_EQ(std::count(begin, end, '\n'), arap::strings::Scanner::count(begin, end, '\n'));
+			}
+		}
+	}
+
+	arap::strings::Scanner::setKernel(detected);
+}
+
+
+TEST(StringOperations, MappedLines)
+{
+	ASSERT_NO_THROW(arap::strings::Utilities::writeToFile("./test-nothing.txt", ""));
+	ASSERT_NO_THROW(arap::strings::Utilities::writeToFile("./test-read.txt", "t"));
+	ASSERT_NO_THROW(arap::strings::Utilities::writeToFile("./test-read2.txt", "t\n\n"));
+	ASSERT_NO_THROW(arap::strings::Utilities::writeToFile("./test-read4.txt", "1\n2\n3\n"));
+
+	ASSERT_TRUE(arap::strings::MappedLines("./test-nothing.txt").getLines().empty());
+	ASSERT_EQ(1, arap::strings::MappedLines("./test-read.txt").getLines().size());
+
+	arap::strings::MappedLines emptyLast("./test-read2.txt");
+	auto lines = emptyLast.getLines();
+	ASSERT_EQ(2, lines.size());
+	ASSERT_EQ("t", lines.front());
+	ASSERT_TRUE(lines.back().empty());
+
+	arap::strings::MappedLines numbers("./test-read4.txt");
+	std::vector<std::string> collected;
+	for (auto line : numbers)
+		collected.emplace_back(line);
+	ASSERT_EQ(arap::strings::Utilities::getLines("./test-read4.txt"), collected);
+
+	ASSERT_THROW(arap::strings::MappedLines("/hullumaja/tere.txt"), std::runtime_error);
+}
+
+TEST(StringOperations, LineReader)
+{
+	ASSERT_NO_THROW(arap::strings::Utilities::writeToFile("./test-nothing.txt", ""));
+	ASSERT_NO_THROW(arap::strings::Utilities::writeToFile("./test-read2.txt", "t\n\n"));
+	ASSERT_NO_THROW(arap::strings::Utilities::writeToFile("./test-read3.txt", "a\na\nc"));
+
+	for (auto path : {"./test-nothing.txt", "./test-read2.txt", "./test-read3.txt"})
+	{
+		auto expected = arap::strings::Utilities::getLines(path);
+
+		std::vector<std::string> fromPath;
+		arap::strings::LineReader pathReader(path);
+		for (auto line : pathReader)
+			fromPath.emplace_back(line);
+		ASSERT_EQ(expected, fromPath);
+
+		std::vector<std::string> fromHandle;
+		FILE* fileHandle = fopen(path, "r");
+		arap::strings::LineReader handleReader(fileHandle);
+		for (auto line : handleReader)
+			fromHandle.emplace_back(line);
+		fclose(fileHandle);
+		ASSERT_EQ(expected, fromHandle);
+
+		std::vector<std::string> fromStream;
+		std::ifstream fileStream(path);
+		arap::strings::LineReader streamReader(fileStream);
+		std::string_view line;
+		while (streamReader.next(line))
+			fromStream.emplace_back(line);
+		ASSERT_EQ(expected, fromStream);
+	}
+
+	ASSERT_THROW(arap::strings::LineReader("/hullumaja/tere.txt"), std::runtime_error);
+}
+
+TEST(StringOperations, ParallelLines)
+{
+	std::string data;
+	for (int i = 0; i < 1000; i++)
+		data += std::to_string(i) + (i % 10 == 0 ? "\n\n" : "\n");
+	data += "last";
+
+	auto chunks = arap::strings::ParallelLines::getChunks(data, 7);
+	ASSERT_LE(chunks.size(), 7);
+	std::string joined;
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		if (i + 1 < chunks.size())
+		{
+			ASSERT_EQ('\n', chunks[i].back());
+		}
+		joined += chunks[i];
+	}
+	ASSERT_EQ(data, joined);
+	ASSERT_TRUE(arap::strings::ParallelLines::getChunks("", 4).empty());
+
+	std::vector<std::string> expected;
+	for (arap::strings::MappedLines::Iterator line(data.data(), data.data() + data.size()), end; line != end; ++line)
+		expected.emplace_back(*line);
+
+	arap::concurrent::ThreadPool pool(4);
+	auto lines = arap::strings::ParallelLines::mapReduce(pool, data, std::vector<std::string>(),
+		[](std::vector<std::string>& partial, std::string_view line) { partial.emplace_back(line); },
+		[](std::vector<std::string>& total, std::vector<std::string>&& partial) { total.insert(total.end(), partial.begin(), partial.end()); });
+	ASSERT_EQ(expected, lines);
+
+	std::atomic<size_t> count(0);
+	arap::strings::ParallelLines::forEachLine(pool, data, [&count](std::string_view) { count++; });
+	ASSERT_EQ(expected.size(), count);
+}
+
+TEST(StringOperations, LineTable)
+{
+	arap::strings::LineTable table;
+	ASSERT_TRUE(table.empty());
+	table.append("first");
+	table.append("");
+	table.append("third");
+	ASSERT_EQ(3, table.size());
+	ASSERT_EQ("first", table[0]);
+	ASSERT_TRUE(table[1].empty());
+	ASSERT_EQ("third", table.at(2));
+	ASSERT_THROW(table.at(3), std::out_of_range);
+	ASSERT_EQ((std::vector<std::string>{"first", "", "third"}), std::vector<std::string>(table.begin(), table.end()));
+
+	ASSERT_NO_THROW(arap::strings::Utilities::writeToFile("./test-nothing.txt", ""));
+	ASSERT_NO_THROW(arap::strings::Utilities::writeToFile("./test-read2.txt", "t\n\n"));
+	ASSERT_NO_THROW(arap::strings::Utilities::writeToFile("./test-read3.txt", "a\na\nc"));
+
+	for (auto path : {"./test-nothing.txt", "./test-read2.txt", "./test-read3.txt"})
+	{
+		arap::strings::Utilities::getLines(path, table);
+		ASSERT_EQ(arap::strings::Utilities::getLines(path), std::vector<std::string>(table.begin(), table.end()));
+
+		arap::strings::LargeLineTable large;
+		arap::strings::Utilities::getLines(path, large);
+		ASSERT_EQ(table.size(), large.size());
+	}
+
+	ASSERT_THROW(arap::strings::Utilities::getLines("/hullumaja/tere.txt", table), std::runtime_error);
+}
+
+TEST(StringOperations, RemoveWhiteSpaceKernelsAgree)
+{
+	const std::string alphabet = std::string(" \t\n\v\f\rab\x80\xff") + '\0';
+	std::mt19937 random(11);
+	auto detected = arap::strings::Scanner::getKernel();
+
+	for (auto kernel : {arap::strings::Scanner::Kernel::scalar, arap::strings::Scanner::Kernel::sse2,
+		arap::strings::Scanner::Kernel::avx2, arap::strings::Scanner::Kernel::avx512})
+	{
+		if (!arap::strings::Scanner::isSupported(kernel))
+			continue;
+
+		arap::strings::Scanner::setKernel(kernel);
+		for (size_t length = 0; length < 300; length++)
+		{
+			std::string source;
+			for (size_t i = 0; i < length; i++)
+				source += alphabet[random() % alphabet.size()];
+
+			std::string expected = source;
+			expected.erase(std::remove_if(expected.begin(), expected.end(),
+				[](char character) { return std::isspace(character, std::locale::classic()); }), expected.end());
+
+			ASSERT_EQ(expected, arap::strings::Utilities::removeWhiteSpace(source));
+			ASSERT_EQ(expected, source);
+		}
+	}
+
+	arap::strings::Scanner::setKernel(detected);
+}
+
+TEST(StringOperations, TrimAndCollapse)
+{
+	ASSERT_EQ("a b", arap::strings::Utilities::trim(" \t a b\r\n"));
+	ASSERT_EQ("a b\r\n", arap::strings::Utilities::trimLeft(" \t a b\r\n"));
+	ASSERT_EQ(" \t a b", arap::strings::Utilities::trimRight(" \t a b\r\n"));
+	ASSERT_TRUE(arap::strings::Utilities::trim(" \n ").empty());
+	ASSERT_TRUE(arap::strings::Utilities::trim("").empty());
+
+	std::string source = " \tJou  \n mees\t\ttere. ";
+	arap::strings::Utilities::collapseWhiteSpace(source);
+	ASSERT_EQ("Jou mees tere.", source);
+
+	source = "  ";
+	arap::strings::Utilities::collapseWhiteSpace(source);
+	ASSERT_TRUE(source.empty());
+}
+
+TEST(StringOperations, FileAppender)
+{
+	const std::string path = "./test-append.txt";
+	std::remove(path.c_str());
+
+	auto policy = arap::strings::FileAppender::defaultPolicy();
+	policy.bufferBytes = 8;
+	policy.maxDelay = std::chrono::hours(1);
+
+	{
+		arap::strings::FileAppender appender(path, policy);
+		appender.append("1\n");
+		appender.append("2\n");
+		ASSERT_EQ(4, appender.getBufferedBytes());
+		ASSERT_TRUE(arap::strings::Utilities::getLines(path).empty());
+
+		// Does not fit, goes out together with the buffer.
+		appender.append("three\n");
+		ASSERT_EQ(0, appender.getBufferedBytes());
+		ASSERT_EQ((std::vector<std::string>{"1", "2", "three"}), arap::strings::Utilities::getLines(path));
+
+		appender.append("4\n");
+		appender.flush();
+		ASSERT_EQ(4, arap::strings::Utilities::getLines(path).size());
+		appender.append("5\n");
+	}
+	ASSERT_EQ(5, arap::strings::Utilities::getLines(path).size());
+
+	policy.maxDelay = std::chrono::milliseconds(0);
+	policy.durability = arap::strings::FileAppender::Durability::everyBytes;
+	policy.syncBytes = 4;
+	arap::strings::FileAppender appender(path, policy);
+	appender.append(std::vector<uint8_t>{'6', '\n'});
+	ASSERT_EQ(0, appender.getBufferedBytes());
+	ASSERT_EQ("6", arap::strings::Utilities::getLines(path).back());
+	ASSERT_NO_THROW(appender.sync());
+
+	policy.syncBytes = 0;
+	ASSERT_THROW(arap::strings::FileAppender(path, policy), std::runtime_error);
+	ASSERT_THROW(arap::strings::FileAppender("/hullumaja/tere.txt"), std::runtime_error);
+
+	std::remove(path.c_str());
+}
+
+// Writes failing halfway, the file size limit cuts the writev() short and fails the next one.
+TEST(StringOperations, FileAppenderFailedWriteKeepsOnlyTheRest)
+{
+	const std::string path = "./test-append.txt";
+	std::remove(path.c_str());
+
+	struct rlimit original;
+	ASSERT_EQ(0, getrlimit(RLIMIT_FSIZE, &original));
+	auto previousHandler = std::signal(SIGXFSZ, SIG_IGN);
+	auto limitSize = [&original](rlim_t size)
+		{
+			struct rlimit limit = original;
+			limit.rlim_cur = size;
+			return setrlimit(RLIMIT_FSIZE, &limit);
+		};
+
+	auto policy = arap::strings::FileAppender::defaultPolicy();
+	policy.bufferBytes = 8;
+	policy.maxDelay = std::chrono::hours(1);
+	{
+		arap::strings::FileAppender appender(path, policy);
+		appender.append("1234567\n");
+
+		// The buffer and half of the extra data reach the file.
+		ASSERT_EQ(0, limitSize(12));
+		ASSERT_THROW(appender.append("abcdefg\n"), std::runtime_error);
+		ASSERT_EQ(4, appender.getBufferedBytes());
+
+		// Only a part of the buffer reaches the file.
+		ASSERT_EQ(0, limitSize(14));
+		ASSERT_THROW(appender.flush(), std::runtime_error);
+		ASSERT_EQ(2, appender.getBufferedBytes());
+
+		ASSERT_EQ(0, setrlimit(RLIMIT_FSIZE, &original));
+		appender.flush();
+	}
+	std::signal(SIGXFSZ, previousHandler);
+	setrlimit(RLIMIT_FSIZE, &original);
+
+	ASSERT_EQ((std::vector<std::string>{"1234567", "abcdefg"}), arap::strings::Utilities::getLines(path));
+	std::remove(path.c_str());
+}
+
+TEST(StringOperations, AsyncWriter)
+{
+	const std::vector<std::string> paths = {"./test-async0.txt", "./test-async1.txt"};
+	for (auto& path : paths)
+		std::remove(path.c_str());
+
+	const size_t producers = 4;
+	const size_t linesPerProducer = 2000;
+	{
+		arap::strings::AsyncWriter writer(paths, arap::strings::AsyncWriter::Overflow::wait, 64);
+		std::vector<std::thread> threads;
+		for (size_t producer = 0; producer < producers; producer++)
+		{
+			threads.emplace_back([&writer, producer]()
+				{
+					for (size_t i = 0; i < linesPerProducer; i++)
+					{
+						auto line = std::to_string(producer) + " " + std::to_string(i) + (i % 100 == 0 ? std::string(200, '.') : "") + "\n";
+						writer.write(producer % 2, line);
+					}
+				});
+		}
+
+		for (auto& thread : threads)
+			thread.join();
+
+		writer.flush();
+		ASSERT_EQ(producers * linesPerProducer / 2, arap::strings::Utilities::getLines(paths[0]).size());
+
+		auto statistics = writer.getStatistics();
+		ASSERT_EQ(0, statistics.droppedBytes);
+		ASSERT_GT(statistics.commits, 0);
+		ASSERT_THROW(writer.write(2, "x"), std::out_of_range);
+	}
+
+	// Lines of every producer keep their order.
+	std::vector<size_t> next(producers, 0);
+	for (auto& path : paths)
+	{
+		for (auto& line : arap::strings::Utilities::getLines(path))
+		{
+			auto fields = arap::strings::Utilities::split(line, " ");
+			auto producer = std::stoul(fields.at(0));
+			ASSERT_EQ(next[producer]++, std::stoul(fields.at(1)));
+		}
+	}
+	ASSERT_EQ(std::vector<size_t>(producers, linesPerProducer), next);
+
+	for (auto& path : paths)
+		std::remove(path.c_str());
+}
+
+TEST(StringOperations, AsyncWriterDropsWhenFull)
+{
+	const std::string path = "./test-async0.txt";
+	std::remove(path.c_str());
+	{
+		arap::strings::AsyncWriter writer({path}, arap::strings::AsyncWriter::Overflow::drop, 2);
+		size_t accepted = 0;
+		for (size_t i = 0; i < 10000; i++)
+			accepted += writer.write(0, "line\n");
+
+		writer.flush();
+		auto statistics = writer.getStatistics();
+		ASSERT_EQ(accepted * 5, statistics.writtenBytes);
+		ASSERT_EQ((10000 - accepted) * 5, statistics.droppedBytes);
+		ASSERT_EQ(10000 - accepted, statistics.droppedWrites);
+		ASSERT_EQ(accepted, arap::strings::Utilities::getLines(path).size());
+	}
+	std::remove(path.c_str());
+}
+
+TEST(StringOperations, AsyncWriterRetriesFailedFlush)
+{
+	const std::string path = "./test-async0.txt";
+	std::remove(path.c_str());
+
+	struct rlimit original;
+	ASSERT_EQ(0, getrlimit(RLIMIT_FSIZE, &original));
+	auto previousHandler = std::signal(SIGXFSZ, SIG_IGN);
+	auto limitSize = [&original](rlim_t size)
+		{
+			struct rlimit limit = original;
+			limit.rlim_cur = size;
+			return setrlimit(RLIMIT_FSIZE, &limit);
+		};
+
+	auto policy = arap::strings::FileAppender::defaultPolicy();
+	policy.bufferBytes = 8;
+	{
+		arap::strings::AsyncWriter writer({path}, policy, arap::strings::AsyncWriter::Overflow::wait, 16);
+
+		ASSERT_EQ(0, limitSize(0));
+		writer.write(0, "first\n");
+		ASSERT_THROW(writer.flush(), std::runtime_error);
+		ASSERT_EQ(0, setrlimit(RLIMIT_FSIZE, &original));
+
+		// Retried without any new data arriving.
+		for (int i = 0; i < 200 && arap::strings::Utilities::getLines(path).empty(); i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+		ASSERT_EQ(std::vector<std::string>{"first"}, arap::strings::Utilities::getLines(path));
+
+		// Half of the first one reaches the file and the rest stays buffered, none of the second one.
+		ASSERT_EQ(0, limitSize(10));
+		writer.write(0, "0123456789\n");
+		ASSERT_THROW(writer.flush(), std::runtime_error);
+		writer.write(0, "lost\n");
+		ASSERT_THROW(writer.flush(), std::runtime_error);
+		ASSERT_EQ(0, setrlimit(RLIMIT_FSIZE, &original));
+
+		writer.write(0, "second\n");
+		writer.flush();
+
+		auto statistics = writer.getStatistics();
+		ASSERT_EQ(6 + 11 + 5 + 7, statistics.writtenBytes + statistics.droppedBytes);
+		ASSERT_EQ(5, statistics.droppedBytes);
+		ASSERT_EQ(1, statistics.droppedWrites);
+	}
+	std::signal(SIGXFSZ, previousHandler);
+	setrlimit(RLIMIT_FSIZE, &original);
+
+	ASSERT_EQ((std::vector<std::string>{"first", "0123456789", "second"}), arap::strings::Utilities::getLines(path));
+	std::remove(path.c_str());
+}
+
+TEST(StringOperations, BatchFileIo)
+{
+	std::vector<arap::linuxOS::BatchFileIo::Backend> backends = {arap::linuxOS::BatchFileIo::Backend::threadPool};
+	if (arap::linuxOS::BatchFileIo().getBackend() == arap::linuxOS::BatchFileIo::Backend::ioUring)
+		backends.push_back(arap::linuxOS::BatchFileIo::Backend::ioUring);
+
+	for (auto backend : backends)
+	{
+		arap::linuxOS::BatchFileIo io(backend);
+		ASSERT_EQ(backend, io.getBackend());
+
+		// Longer than a read chunk, written over an existing file, and empty.
+		std::vector<arap::linuxOS::BatchFileIo::WriteRequest> requests = {
+			{"./test-batch0.txt", "tere\n"},
+			{"./test-batch1.txt", std::string(200000, 'x')},
+			{"./test-batch2.txt", ""}};
+		arap::strings::Utilities::writeToFile("./test-batch2.txt", "previous");
+
+		ASSERT_EQ(std::vector<int>(3, 0), io.writeFiles(requests));
+		ASSERT_EQ(std::vector<int>(1, 0), io.writeFiles({{"./test-batch0.txt", "maailm\n"}}, false));
+		ASSERT_NE(0, io.writeFiles({{"/hullumaja/tere.txt", "tere"}}).at(0));
+
+		auto results = io.readFiles({"./test-batch0.txt", "./test-batch1.txt", "./test-batch2.txt", "./test-batch-missing.txt"});
+		ASSERT_EQ(4, results.size());
+		ASSERT_EQ("tere\nmaailm\n", results[0].data);
+		ASSERT_EQ(requests[1].data, results[1].data);
+		ASSERT_TRUE(results[2].data.empty());
+		for (size_t i = 0; i < 3; i++)
+			ASSERT_EQ(0, results[i].error);
+		ASSERT_EQ(ENOENT, results[3].error);
+
+		for (auto& request : requests)
+			std::remove(request.path.c_str());
+	}
+}
+
+TEST(StringOperations, InternPool)
+{
+	arap::strings::InternPool pool;
+	ASSERT_TRUE(pool.empty());
+
+	std::vector<arap::strings::InternPool::Id> ids;
+	ASSERT_EQ(6, arap::strings::Tokenizer("up down up up  down", " ").appendIdsTo(pool, ids));
+	ASSERT_EQ((std::vector<arap::strings::InternPool::Id>{0, 1, 0, 0, 2, 1}), ids);
+	ASSERT_EQ(3, pool.size());
+	ASSERT_EQ("down", pool[1]);
+	ASSERT_EQ("", pool.at(2));
+	ASSERT_EQ((std::vector<uint64_t>{3, 2, 1}), pool.getCounts());
+	ASSERT_THROW(pool.at(3), std::out_of_range);
+
+	arap::strings::InternPool::Id id;
+	ASSERT_TRUE(pool.find("up", id));
+	ASSERT_EQ(0, id);
+	ASSERT_FALSE(pool.find("sideways", id));
+	ASSERT_EQ(3, pool.getCount(0));
+
+	// Views stay put while the table grows and the arena gets more blocks.
+	auto first = pool[0];
+	std::string longText(100000, 'x');
+	for (size_t i = 0; i < 100000; i++)
+		ASSERT_EQ(i + 3, pool.intern("token" + std::to_string(i)));
+	ASSERT_EQ(100003, pool.intern(longText));
+	ASSERT_EQ(first.data(), pool[0].data());
+	ASSERT_EQ(longText, pool[100003]);
+
+	for (size_t i = 0; i < 100000; i += 997)
+	{
+		ASSERT_EQ(i + 3, pool.intern("token" + std::to_string(i)));
+		ASSERT_EQ(2, pool.getCount(i + 3));
+	}
+	ASSERT_GT(pool.getMemoryUsage(), longText.size());
 }
 
+TEST(StringOperations, FileFollower)
+{
+	const std::string path = "./test-follow.txt";
+	const std::string rotated = "./test-follow.txt.1";
+	std::remove(path.c_str());
+	std::remove(rotated.c_str());
+
+	arap::strings::Utilities::writeToFile(path, "old\nunfini");
+	arap::strings::FileFollower follower(path);
+	std::vector<std::string> lines;
+	ASSERT_EQ(0, follower.read(lines));
+	ASSERT_EQ(10, follower.getOffset());
+
+	arap::strings::Utilities::writeToFile(path, "shed\nnew\npart", false);
+	ASSERT_TRUE(follower.wait(std::chrono::seconds(1)));
+	ASSERT_EQ(2, follower.read(lines));
+	ASSERT_EQ((std::vector<std::string>{"unfinished", "new"}), lines);
+	ASSERT_FALSE(follower.wait(std::chrono::milliseconds(0)));
+
+	arap::strings::Utilities::writeToFile(path, "ial\n", false);
+	lines.clear();
+	follower.read(lines);
+	ASSERT_EQ((std::vector<std::string>{"partial"}), lines);
+
+	// Truncated and written again.
+	arap::strings::Utilities::writeToFile(path, "short\n");
+	lines.clear();
+	follower.read(lines);
+	ASSERT_EQ((std::vector<std::string>{"short"}), lines);
+
+	// Rotated, the writer finishes the old file before the new one shows up.
+	arap::strings::Utilities::writeToFile(path, "last\nend", false);
+	ASSERT_EQ(0, std::rename(path.c_str(), rotated.c_str()));
+	arap::strings::Utilities::writeToFile(rotated, "ing\nleft", false);
+	arap::strings::Utilities::writeToFile(path, "fresh\n");
+	ASSERT_TRUE(follower.wait(std::chrono::seconds(1)));
+	lines.clear();
+	ASSERT_EQ(4, follower.read(lines));
+	ASSERT_EQ((std::vector<std::string>{"last", "ending", "left", "fresh"}), lines);
+
+	// Removed, then created again.
+	std::remove(path.c_str());
+	lines.clear();
+	ASSERT_EQ(0, follower.read(lines));
+	arap::strings::Utilities::writeToFile(path, "again\n");
+	follower.read(lines);
+	ASSERT_EQ((std::vector<std::string>{"again"}), lines);
+
+	arap::strings::FileFollower fromStart(path, true);
+	lines.clear();
+	fromStart.read(lines);
+	ASSERT_EQ((std::vector<std::string>{"again"}), lines);
+
+	ASSERT_THROW(arap::strings::FileFollower("/hullumaja/tere.txt"), std::runtime_error);
+
+	std::remove(path.c_str());
+	std::remove(rotated.c_str());
+}
+
+TEST(StringOperations, FileFollowerLongUnfinishedLine)
+{
+	const std::string path = "./test-follow.txt";
+	const std::string longLine(200 * 1024, 'x');
+	arap::strings::Utilities::writeToFile(path, "old\n" + longLine);
+
+	arap::strings::FileFollower follower(path);
+	std::vector<std::string> lines;
+	ASSERT_EQ(0, follower.read(lines));
+
+	arap::strings::Utilities::writeToFile(path, "\n", false);
+	ASSERT_EQ(1, follower.read(lines));
+	ASSERT_EQ(std::vector<std::string>{longLine}, lines);
+
+	// Timeouts beyond the range of poll() or of the clock do not wrap around to short ones.
+	std::thread writer([&path]()
+		{
+			for (auto line : {"late\n", "later\n"})
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(200));
+				arap::strings::Utilities::writeToFile(path, line, false);
+			}
+		});
+	auto beyondPoll = follower.wait(std::chrono::milliseconds((int64_t(1) << 32) + 50));
+	auto beyondClock = follower.wait(std::chrono::milliseconds::max());
+	writer.join();
+	ASSERT_TRUE(beyondPoll);
+	ASSERT_TRUE(beyondClock);
+
+	std::remove(path.c_str());
+}
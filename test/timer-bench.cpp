@@ -0,0 +1,303 @@
+#include <atomic>
+#include <functional>
+#include <random>
+#include <thread>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+
+#include "ArapTimers.h"
+
+namespace
+{
+	const std::vector<size_t> timerCounts = {1000, 10000, 100000, 1000000};
+}
+
+// Ticks where nothing is due, cost must not depend on the amount of timers in the wheel.
+BENCHMARK(TimerWheel, IdleTick)
+{
+	for (auto count : timerCounts)
+	{
+		arap::TimerWheel wheel(0);
+		std::mt19937 random(count);
+		std::uniform_int_distribution<uint32_t> timeouts(100000, 1000000);
+		for (size_t i = 0; i < count; i++)
+			wheel.add(timeouts(random), nullptr);
+
+		const time_t ticks = 200;
+		benchmark::Stopwatch stopwatch;
+		size_t fired = 0;
+		for (time_t now = 1; now <= ticks; now++)
+			fired += wheel.expire(now);
+
+		benchmark::doNotOptimize(fired);
+		benchmark::report("wheel " + std::to_string(count) + " timers", stopwatch.nanoseconds() / ticks, "ns/tick");
+	}
+}
+
+// Every timer fires once, includes cascading between the levels.
+BENCHMARK(TimerWheel, AmortizedExpiration)
+{
+	for (auto count : timerCounts)
+	{
+		arap::TimerWheel wheel(0);
+		std::mt19937 random(count);
+		std::uniform_int_distribution<uint32_t> timeouts(1, 86400);
+		for (size_t i = 0; i < count; i++)
+			wheel.add(timeouts(random), nullptr);
+
+		benchmark::Stopwatch stopwatch;
+		size_t fired = 0;
+		for (time_t now = 1; now <= 86400; now++)
+			fired += wheel.expire(now);
+
+		benchmark::report("wheel " + std::to_string(count) + " timers", stopwatch.nanoseconds() / fired, "ns/timer");
+		benchmark::report("wheel " + std::to_string(count) + " timers", stopwatch.nanoseconds() / 86400, "ns/tick");
+	}
+}
+
+BENCHMARK(TimerWheel, InsertCancel)
+{
+	for (auto count : timerCounts)
+	{
+		arap::TimerWheel wheel(0);
+		std::vector<arap::TimerWheel::Id> ids(count);
+		std::mt19937 random(count);
+		std::uniform_int_distribution<uint32_t> timeouts(1, 86400);
+
+		benchmark::Stopwatch stopwatch;
+		for (size_t i = 0; i < count; i++)
+			ids[i] = wheel.add(timeouts(random), nullptr);
+		benchmark::report("insert " + std::to_string(count) + " timers", stopwatch.nanoseconds() / count, "ns/timer");
+
+		stopwatch.restart();
+		for (auto id : ids)
+			wheel.cancel(id);
+		benchmark::report("cancel " + std::to_string(count) + " timers", stopwatch.nanoseconds() / count, "ns/timer");
+	}
+}
+
+// Periodic device timers on a millisecond wheel driven like an event loop sleeping until the next
+// timeout, simulated time so the wake-ups are counted without sleeping.
+BENCHMARK(TimerWheel, SlackWakeUps)
+{
+	const std::vector<int64_t> slacks = {0, 10, 100, 1000};
+	const size_t count = 500;
+	const uint64_t simulatedTicks = 600000;
+
+	for (auto slack : slacks)
+	{
+		arap::BasicTimerWheel<arap::clocks::Manual, 1000000> wheel(0);
+		wheel.setSlack(std::chrono::milliseconds(slack));
+
+		std::mt19937 random(count);
+		std::uniform_int_distribution<uint32_t> periods(1000, 60000);
+		std::vector<std::function<void()>> rearms(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			auto period = periods(random);
+			rearms[i] = [&wheel, &rearms, i, period]() { wheel.addTicks(period, rearms[i]); };
+			wheel.addTicks(period, rearms[i]);
+		}
+
+		uint64_t now = 0;
+		size_t wakeUps = 0;
+		size_t fired = 0;
+		benchmark::Stopwatch stopwatch;
+		while (true)
+		{
+			now += wheel.nextTimeoutTicks();
+			if (now > simulatedTicks)
+				break;
+
+			fired += wheel.expire(static_cast<time_t>(now));
+			wakeUps++;
+		}
+
+		auto label = std::to_string(count) + " timers slack " + std::to_string(slack) + " ms";
+		benchmark::report(label, static_cast<double>(wakeUps) * 1000 / simulatedTicks, "wake-ups/s");
+		benchmark::report(label, static_cast<double>(fired) / wakeUps, "timers/wake-up");
+		benchmark::report(label, stopwatch.nanoseconds() / fired, "ns/timer");
+	}
+}
+
+// Baseline - one SimpleTimer per device polled on every loop iteration.
+BENCHMARK(SimpleTimer, PollingScan)
+{
+	for (auto count : timerCounts)
+	{
+		std::vector<arap::SimpleTimer> timers(count);
+		for (auto& timer : timers)
+			timer.set(3600);
+
+		const size_t iterations = 10;
+		benchmark::Stopwatch stopwatch;
+		size_t expired = 0;
+		for (size_t i = 0; i < iterations; i++)
+		{
+			for (auto& timer : timers)
+				expired += timer.expired();
+		}
+
+		benchmark::doNotOptimize(expired);
+		benchmark::report("scan " + std::to_string(count) + " timers", stopwatch.nanoseconds() / iterations, "ns/tick");
+	}
+}
+
+namespace
+{
+	template <typename Read>
+	void measureClockRead(const std::string& label, Read read)
+	{
+		const size_t iterations = 10000000;
+		int64_t sum = 0;
+
+		benchmark::Stopwatch stopwatch;
+		for (size_t i = 0; i < iterations; i++)
+			sum += read();
+
+		benchmark::doNotOptimize(sum);
+		benchmark::report(label, stopwatch.nanoseconds() / iterations, "ns/read");
+	}
+}
+
+BENCHMARK(Clock, Reads)
+{
+	measureClockRead("std::time", []() { return static_cast<int64_t>(std::time(nullptr)); });
+	measureClockRead("CLOCK_MONOTONIC", []() { return arap::Clock::monotonic(); });
+	measureClockRead("CLOCK_REALTIME", []() { return arap::Clock::realtime(); });
+	measureClockRead("CLOCK_MONOTONIC_COARSE", []() { return arap::Clock::monotonicCoarse(); });
+	measureClockRead("CLOCK_REALTIME_COARSE", []() { return arap::Clock::realtimeCoarse(); });
+	measureClockRead("cached monotonic", []() { return arap::Clock::cachedMonotonic(); });
+}
+
+// Timer logic alone against the same scan paying for a clock read per timer.
+BENCHMARK(SimpleTimer, ClockPolicies)
+{
+	const size_t count = 100000;
+	const size_t iterations = 20;
+
+	std::vector<arap::BasicSimpleTimer<arap::clocks::Manual>> manualTimers(count);
+	std::vector<arap::BasicSimpleTimer<arap::clocks::System>> systemTimers(count);
+	std::vector<arap::BasicSimpleTimer<arap::clocks::MonotonicCoarse>> coarseTimers(count);
+	std::vector<arap::BasicSimpleTimer<arap::clocks::CachedMonotonic>> cachedTimers(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		manualTimers[i].set(3600);
+		systemTimers[i].set(3600);
+		coarseTimers[i].set(3600);
+		cachedTimers[i].set(3600);
+	}
+
+	size_t expired = 0;
+	benchmark::Stopwatch stopwatch;
+	for (size_t i = 0; i < iterations; i++)
+	{
+		for (auto& timer : manualTimers)
+			expired += timer.expired();
+	}
+	benchmark::report("manual clock", stopwatch.nanoseconds() / (iterations * count), "ns/timer");
+
+	stopwatch.restart();
+	for (size_t i = 0; i < iterations; i++)
+	{
+		for (auto& timer : systemTimers)
+			expired += timer.expired();
+	}
+	benchmark::report("system clock", stopwatch.nanoseconds() / (iterations * count), "ns/timer");
+
+	stopwatch.restart();
+	for (size_t i = 0; i < iterations; i++)
+	{
+		for (auto& timer : coarseTimers)
+			expired += timer.expired();
+	}
+	benchmark::report("monotonic coarse clock", stopwatch.nanoseconds() / (iterations * count), "ns/timer");
+
+	stopwatch.restart();
+	for (size_t i = 0; i < iterations; i++)
+	{
+		arap::Clock::refresh();
+		for (auto& timer : cachedTimers)
+			expired += timer.expired();
+	}
+	benchmark::report("cached monotonic clock", stopwatch.nanoseconds() / (iterations * count), "ns/timer");
+
+	benchmark::doNotOptimize(expired);
+}
+
+// One clock read and a vectorized comparison per sweep against a virtual call and std::time() per timer.
+BENCHMARK(TimerArray, ExpirySweep)
+{
+	for (auto count : timerCounts)
+	{
+		arap::TimerArray timers;
+		std::vector<arap::SimpleTimer> simpleTimers(count);
+		std::mt19937 random(count);
+		std::uniform_int_distribution<uint32_t> timeouts(1, 86400);
+		for (auto& timer : simpleTimers)
+		{
+			auto timeout = timeouts(random);
+			timer.set(timeout);
+			timers.add(timeout);
+		}
+
+		const size_t iterations = 20;
+		std::vector<uint64_t> bitmask;
+		std::vector<arap::TimerArray::Index> indices;
+		size_t expired = 0;
+
+		benchmark::Stopwatch stopwatch;
+		for (size_t i = 0; i < iterations; i++)
+			expired += timers.expired(bitmask);
+		benchmark::report("array bitmask " + std::to_string(count) + " timers", stopwatch.nanoseconds() / iterations, "ns/sweep");
+
+		stopwatch.restart();
+		for (size_t i = 0; i < iterations; i++)
+			expired += timers.expired(std::time(nullptr) + 3600, indices);
+		benchmark::report("array indices " + std::to_string(count) + " timers", stopwatch.nanoseconds() / iterations, "ns/sweep");
+
+		stopwatch.restart();
+		for (size_t i = 0; i < iterations; i++)
+		{
+			for (auto& timer : simpleTimers)
+				expired += timer.expired();
+		}
+		benchmark::report("vector<SimpleTimer> " + std::to_string(count) + " timers", stopwatch.nanoseconds() / iterations, "ns/sweep");
+
+		benchmark::doNotOptimize(expired);
+	}
+}
+
+// Arm and cancel pairs from a growing amount of producer threads.
+BENCHMARK(TimerService, ProducerContention)
+{
+	const size_t operations = 400000;
+
+	for (size_t producerCount : {1, 2, 4, 8, 16, 32, 64})
+	{
+		arap::TimerService service;
+		std::atomic<bool> start(false);
+		std::vector<std::thread> producers;
+
+		for (size_t producer = 0; producer < producerCount; producer++)
+		{
+			producers.emplace_back([&service, &start, producerCount]()
+			{
+				while (!start.load())
+					std::this_thread::yield();
+
+				for (size_t i = 0; i < operations / producerCount / 2; i++)
+					service.cancel(service.arm(std::chrono::milliseconds(3600 * 1000), nullptr));
+			});
+		}
+
+		benchmark::Stopwatch stopwatch;
+		start = true;
+		for (auto& thread : producers)
+			thread.join();
+
+		benchmark::report(std::to_string(producerCount) + " producers", stopwatch.nanoseconds() / operations, "ns/command");
+	}
+}
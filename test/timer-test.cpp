@@ -1,75 +1,634 @@
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <random>
+#include <thread>
+
+#include <poll.h>
+
 #include "gtest/gtest.h"
 
 #include "ArapTimers.h"
 
+namespace
+{
+	using ManualClock = arap::clocks::Manual;
+	using ManualSimpleTimer = arap::BasicSimpleTimer<ManualClock>;
+	using ManualMonotonicTimer = arap::BasicMonotonicTimer<ManualClock>;
+	using ManualTimerArray = arap::BasicTimerArray<ManualClock>;
+}
+
 TEST(SimpleTimer, Expiration)
 {
-	arap::SimpleTimer timerTest(1);
+	ManualSimpleTimer timerTest(1);
 	ASSERT_FALSE(timerTest.expired());
-	sleep(1);
+	ManualClock::advance(std::chrono::seconds(1));
 	ASSERT_TRUE(timerTest.expired());
 }
 
 TEST(SimpleTimer, ExpirationWithPause)
 {
-	arap::SimpleTimer timerTest(1);
+	ManualSimpleTimer timerTest(1);
 	ASSERT_FALSE(timerTest.expired());
 	timerTest.pause();
 	ASSERT_FALSE(timerTest.expired());
 	timerTest.run();
 	ASSERT_FALSE(timerTest.expired());
-	sleep(1);
+	ManualClock::advance(std::chrono::seconds(1));
 	ASSERT_TRUE(timerTest.expired());
 }
 
 TEST(SimpleTimer, ExpirationWithStop)
 {
-	arap::SimpleTimer timerTest(1);
+	ManualSimpleTimer timerTest(1);
 	ASSERT_FALSE(timerTest.expired());
 	timerTest.stop();
 	ASSERT_FALSE(timerTest.expired());
 	timerTest.run();
 	ASSERT_FALSE(timerTest.expired());
-	sleep(1);
+	ManualClock::advance(std::chrono::seconds(1));
 	ASSERT_TRUE(timerTest.expired());
 }
 
 TEST(SimpleTimer, ElapsedMeasuring)
 {
-	arap::SimpleTimer timerTest(3);
-	sleep(1);
+	ManualSimpleTimer timerTest(3);
+	ManualClock::advance(std::chrono::seconds(1));
 	ASSERT_EQ(1, timerTest.elapsed());
-	sleep(1);
+	ManualClock::advance(std::chrono::seconds(1));
 	ASSERT_EQ(2, timerTest.elapsed());
-	sleep(1);
+	ManualClock::advance(std::chrono::seconds(1));
 	ASSERT_EQ(3, timerTest.elapsed());
-	sleep(1);
+	ManualClock::advance(std::chrono::seconds(1));
 	ASSERT_EQ(3, timerTest.elapsed());
 
-	arap::SimpleTimer timerTest2(1);
+	ManualSimpleTimer timerTest2(1);
 	ASSERT_EQ(0, timerTest2.elapsed());
 	timerTest2.pause();
 	ASSERT_EQ(0, timerTest2.elapsed());
-	sleep(1);
+	ManualClock::advance(std::chrono::seconds(1));
 	ASSERT_EQ(1, timerTest2.elapsed());
-	sleep(1);
+	ManualClock::advance(std::chrono::seconds(1));
 	ASSERT_EQ(1, timerTest2.elapsed());
 	
-	arap::SimpleTimer timerTest3(1);
+	ManualSimpleTimer timerTest3(1);
 	timerTest3.stop();
 	ASSERT_EQ(0, timerTest3.elapsed());
-	sleep(1);
+	ManualClock::advance(std::chrono::seconds(1));
 	ASSERT_EQ(0, timerTest3.elapsed());
 }
 
 TEST(SimpleTimer, NoExpirationWhenDefaultCtor)
 {
-	arap::SimpleTimer timerTest;
+	ManualSimpleTimer timerTest;
+	ASSERT_FALSE(timerTest.expired());
+	ManualClock::advance(std::chrono::seconds(1));
+	ASSERT_FALSE(timerTest.expired());
+
+	ManualSimpleTimer timerTest2;
+	timerTest2.stop();
+	ASSERT_FALSE(timerTest2.expired());
+}
+
+TEST(MonotonicTimer, Expiration)
+{
+	ManualMonotonicTimer timerTest(std::chrono::milliseconds(50));
+	ASSERT_FALSE(timerTest.expired());
+	ManualClock::advance(std::chrono::milliseconds(50));
+	ASSERT_TRUE(timerTest.expired());
+
+	ManualMonotonicTimer timerTest2(1);
+	ASSERT_FALSE(timerTest2.expired());
+	ManualClock::advance(std::chrono::seconds(1));
+	ASSERT_TRUE(timerTest2.expired());
+
+	ManualMonotonicTimer timerTest3(std::chrono::seconds(2));
+	timerTest3.set(std::chrono::seconds(5));
+	ManualClock::advance(std::chrono::seconds(4));
+	ASSERT_FALSE(timerTest3.expired());
+	ManualClock::advance(std::chrono::seconds(1));
+	ASSERT_TRUE(timerTest3.expired());
+}
+
+TEST(MonotonicTimer, ExpirationWithPause)
+{
+	ManualMonotonicTimer timerTest(std::chrono::milliseconds(100));
+	ManualClock::advance(std::chrono::milliseconds(40));
+	timerTest.pause();
+	ManualClock::advance(std::chrono::milliseconds(100));
+	ASSERT_FALSE(timerTest.expired());
+	timerTest.run();
+	ASSERT_FALSE(timerTest.expired());
+	ManualClock::advance(std::chrono::milliseconds(60));
+	ASSERT_TRUE(timerTest.expired());
+}
+
+TEST(MonotonicTimer, ExpirationWithStop)
+{
+	ManualMonotonicTimer timerTest(std::chrono::milliseconds(50));
+	ASSERT_FALSE(timerTest.expired());
+	timerTest.stop();
+	ManualClock::advance(std::chrono::milliseconds(50));
+	ASSERT_FALSE(timerTest.expired());
+	timerTest.run();
+	ASSERT_FALSE(timerTest.expired());
+	ManualClock::advance(std::chrono::milliseconds(50));
+	ASSERT_TRUE(timerTest.expired());
+}
+
+TEST(MonotonicTimer, ElapsedMeasuring)
+{
+	ManualMonotonicTimer timerTest(std::chrono::microseconds(300000));
+	ManualClock::advance(std::chrono::milliseconds(100));
+	ASSERT_EQ(100 * 1000 * 1000, timerTest.elapsedNanoseconds());
+	ASSERT_EQ(0, timerTest.elapsed());
+	ASSERT_EQ(1, timerTest.nextTimeout());
+	ASSERT_EQ(200, timerTest.nextTimeoutMilliseconds());
+	ManualClock::advance(std::chrono::nanoseconds(1));
+	ASSERT_EQ(200, timerTest.nextTimeoutMilliseconds());
+	ManualClock::advance(std::chrono::milliseconds(200));
+	ASSERT_EQ(300 * 1000 * 1000, timerTest.elapsedNanoseconds());
+	ASSERT_EQ(0, timerTest.nextTimeoutNanoseconds());
+
+	ManualMonotonicTimer timerTest2(std::chrono::milliseconds(100));
+	ManualClock::advance(std::chrono::milliseconds(20));
+	timerTest2.pause();
+	ManualClock::advance(std::chrono::milliseconds(100));
+	ASSERT_EQ(20 * 1000 * 1000, timerTest2.elapsedNanoseconds());
+
+	ManualMonotonicTimer timerTest3(std::chrono::milliseconds(50));
+	timerTest3.stop();
+	ASSERT_EQ(0, timerTest3.elapsedNanoseconds());
+	ManualClock::advance(std::chrono::milliseconds(50));
+	ASSERT_EQ(0, timerTest3.elapsedNanoseconds());
+}
+
+TEST(MonotonicTimer, Reset)
+{
+	ManualMonotonicTimer timerTest(std::chrono::milliseconds(50));
+	ManualClock::advance(std::chrono::milliseconds(50));
+	ASSERT_TRUE(timerTest.expired());
+	timerTest.reset();
+	ASSERT_FALSE(timerTest.expired());
+	ManualClock::advance(std::chrono::milliseconds(50));
+	ASSERT_TRUE(timerTest.expired());
+}
+
+TEST(MonotonicTimer, RealClockExpiration)
+{
+	arap::MonotonicTimer timerTest(std::chrono::milliseconds(20));
+	ASSERT_FALSE(timerTest.expired());
+	usleep(20 * 1000);
+	ASSERT_TRUE(timerTest.expired());
+}
+
+TEST(MonotonicTimer, NoExpirationWhenDefaultCtor)
+{
+	ManualMonotonicTimer timerTest;
 	ASSERT_FALSE(timerTest.expired());
-	sleep(1);
+	ManualClock::advance(std::chrono::milliseconds(10));
 	ASSERT_FALSE(timerTest.expired());
 
-	arap::SimpleTimer timerTest2;
+	ManualMonotonicTimer timerTest2;
 	timerTest2.stop();
 	ASSERT_FALSE(timerTest2.expired());
 }
+
+TEST(TimerWheel, Expiration)
+{
+	arap::TimerWheel wheel(1000);
+	uint32_t fired = 0;
+
+	wheel.add(1, [&fired]() { fired++; });
+	wheel.add(5, [&fired]() { fired++; });
+	ASSERT_EQ(2, wheel.size());
+	ASSERT_EQ(1, wheel.nextTimeout());
+
+	ASSERT_EQ(0, wheel.expire(1000));
+	ASSERT_EQ(1, wheel.expire(1001));
+	ASSERT_EQ(1, fired);
+	ASSERT_EQ(4, wheel.nextTimeout());
+
+	ASSERT_EQ(0, wheel.expire(1004));
+	ASSERT_EQ(1, wheel.expire(1010));
+	ASSERT_EQ(2, fired);
+	ASSERT_TRUE(wheel.empty());
+	ASSERT_EQ(std::numeric_limits<uint32_t>::max(), wheel.nextTimeout());
+}
+
+TEST(TimerWheel, Cancel)
+{
+	arap::TimerWheel wheel(0);
+	bool fired = false;
+
+	auto id = wheel.add(3, [&fired]() { fired = true; });
+	ASSERT_TRUE(wheel.cancel(id));
+	ASSERT_FALSE(wheel.cancel(id));
+	ASSERT_EQ(0, wheel.expire(10));
+	ASSERT_FALSE(fired);
+
+	auto reusedId = wheel.add(1, nullptr);
+	ASSERT_NE(id, reusedId);
+	ASSERT_FALSE(wheel.cancel(id));
+	ASSERT_EQ(1, wheel.expire(11));
+	ASSERT_FALSE(wheel.cancel(reusedId));
+}
+
+TEST(TimerWheel, CascadingLevels)
+{
+	arap::TimerWheel wheel(100);
+	std::vector<uint32_t> timeouts = {255, 256, 300, 65535, 65536, 70000, 16777216, 20000000};
+	std::vector<uint32_t> firedAt;
+
+	for (auto timeout : timeouts)
+		wheel.add(timeout, [&firedAt, timeout]() { firedAt.push_back(timeout); });
+
+	for (auto timeout : timeouts)
+	{
+		ASSERT_EQ(timeout - (firedAt.empty() ? 0 : firedAt.back()), wheel.nextTimeout());
+		ASSERT_EQ(0, wheel.expire(100 + timeout - 1));
+		ASSERT_EQ(1, wheel.expire(100 + timeout));
+	}
+
+	ASSERT_EQ(timeouts.size(), firedAt.size());
+}
+
+TEST(TimerWheel, ClockPolicy)
+{
+	arap::BasicTimerWheel<ManualClock> wheel;
+	wheel.add(2, nullptr);
+
+	ManualClock::advance(std::chrono::seconds(1));
+	ASSERT_EQ(0, wheel.expire());
+	ManualClock::advance(std::chrono::seconds(1));
+	ASSERT_EQ(1, wheel.expire());
+}
+
+TEST(TimerWheel, CallbackRearms)
+{
+	arap::TimerWheel wheel(0);
+	uint32_t fired = 0;
+
+	std::function<void()> periodic = [&]() 
+	{ 
+		fired++;
+		wheel.add(2, periodic);
+	};
+	wheel.add(2, periodic);
+
+	for (time_t now = 0; now <= 10; now++)
+		wheel.expire(now);
+
+	ASSERT_EQ(5, fired);
+	ASSERT_EQ(1, wheel.size());
+}
+
+TEST(DescriptorTimer, PollExpiration)
+{
+	arap::DescriptorTimer timerTest(std::chrono::milliseconds(50));
+	struct pollfd pollDescriptor = {timerTest.getFileDescriptor(), POLLIN, 0};
+
+	ASSERT_EQ(0, poll(&pollDescriptor, 1, 0));
+	ASSERT_FALSE(timerTest.expired());
+
+	ASSERT_EQ(1, poll(&pollDescriptor, 1, 1000));
+	ASSERT_TRUE(timerTest.expired());
+	ASSERT_EQ(1, timerTest.acknowledge());
+	ASSERT_EQ(0, poll(&pollDescriptor, 1, 0));
+
+	timerTest.reset();
+	ASSERT_FALSE(timerTest.expired());
+	ASSERT_EQ(1, poll(&pollDescriptor, 1, 1000));
+	ASSERT_TRUE(timerTest.expired());
+}
+
+TEST(DescriptorTimer, PauseAndStopDisarm)
+{
+	arap::DescriptorTimer timerTest(std::chrono::milliseconds(50));
+	struct pollfd pollDescriptor = {timerTest.getFileDescriptor(), POLLIN, 0};
+
+	timerTest.pause();
+	ASSERT_EQ(0, poll(&pollDescriptor, 1, 100));
+	timerTest.run();
+	ASSERT_EQ(1, poll(&pollDescriptor, 1, 1000));
+
+	timerTest.set(std::chrono::milliseconds(50));
+	timerTest.stop();
+	ASSERT_EQ(0, poll(&pollDescriptor, 1, 100));
+
+	arap::DescriptorTimer timerTest2;
+	pollDescriptor.fd = timerTest2.getFileDescriptor();
+	ASSERT_EQ(0, poll(&pollDescriptor, 1, 10));
+}
+
+TEST(TimerArray, ExpirationSweep)
+{
+	ManualTimerArray timers;
+	auto now = ManualClock::seconds();
+
+	for (uint32_t i = 0; i < 150; i++)
+		timers.add(i % 3 == 0 ? 0 : 10 + i);
+
+	std::vector<uint64_t> bitmask;
+	std::vector<ManualTimerArray::Index> indices;
+	ASSERT_EQ(0, timers.expired(now, bitmask));
+	ASSERT_EQ(3, bitmask.size());
+
+	ASSERT_EQ(7, timers.expired(now + 20, indices));
+	ASSERT_EQ(1, indices.front());
+	ASSERT_EQ(10, indices.back());
+
+	ASSERT_EQ(100, timers.expired(now + 200, bitmask));
+	ASSERT_EQ(0, bitmask[0] & 1);
+	ASSERT_EQ(1, (bitmask[2] >> (149 - 128)) & 1);
+}
+
+TEST(TimerArray, SweepKernelsAgree)
+{
+	auto detected = arap::DeadlineSweep::getKernel();
+	const int64_t now = 1000;
+	std::mt19937 random(7);
+	std::vector<int64_t> deadlines(64 * 16);
+	for (auto& deadline : deadlines)
+	{
+		switch (random() % 4)
+		{
+		case 0:
+			deadline = now;
+			break;
+		case 1:
+			deadline = std::numeric_limits<int64_t>::max();
+			break;
+		default:
+			deadline = now - 40 + static_cast<int64_t>(random() % 80);
+		}
+	}
+
+	for (auto kernel : {arap::DeadlineSweep::Kernel::scalar, arap::DeadlineSweep::Kernel::sse42, arap::DeadlineSweep::Kernel::avx2})
+	{
+		if (!arap::DeadlineSweep::isSupported(kernel))
+		{
+			ASSERT_THROW(arap::DeadlineSweep::setKernel(kernel), std::runtime_error);
+			continue;
+		}
+
+		arap::DeadlineSweep::setKernel(kernel);
+		for (size_t first = 0; first < deadlines.size(); first += 64)
+		{
+			uint64_t expected = 0;
+			for (size_t i = 0; i < 64; i++)
+				expected |= static_cast<uint64_t>(deadlines[first + i] <= now) << i;
+
+			ASSERT_EQ(expected, arap::DeadlineSweep::block(deadlines.data() + first, now));
+		}
+	}
+
+	arap::DeadlineSweep::setKernel(detected);
+}
+
+TEST(TimerArray, PauseStopAndReset)
+{
+	ManualTimerArray timers;
+	auto now = ManualClock::seconds();
+	auto first = timers.add(100);
+	auto second = timers.add(100);
+
+	timers.pause(first);
+	timers.stop(second);
+	ASSERT_FALSE(timers.expired(first, now + 1000));
+	ASSERT_FALSE(timers.expired(second, now + 1000));
+	ASSERT_EQ(0, timers.elapsed(second, now + 1000));
+
+	timers.run(first);
+	timers.run(second);
+	ASSERT_TRUE(timers.expired(first, now + 101 + 1));
+	ASSERT_TRUE(timers.expired(second, now + 101 + 1));
+	ASSERT_EQ(100, timers.elapsed(first, now + 200));
+
+	timers.reset(first);
+	ASSERT_FALSE(timers.expired(first, now + 101 + 1));
+	ASSERT_TRUE(timers.expired(first, now + 201 + 1));
+}
+
+TEST(Clock, CachedUntilRefresh)
+{
+	arap::Clock::refresh();
+	auto cached = arap::Clock::cachedMonotonic();
+	usleep(2 * 1000);
+	ASSERT_EQ(cached, arap::Clock::cachedMonotonic());
+	ASSERT_GT(arap::Clock::monotonic(), cached);
+
+	arap::BasicMonotonicTimer<arap::clocks::CachedMonotonic> timerTest(std::chrono::milliseconds(5));
+	usleep(10 * 1000);
+	ASSERT_FALSE(timerTest.expired());
+	arap::Clock::refresh();
+	ASSERT_TRUE(timerTest.expired());
+	ASSERT_GT(arap::Clock::cachedMonotonic(), cached);
+}
+
+TEST(Clock, CoarseReads)
+{
+	auto coarse = arap::Clock::monotonicCoarse();
+	ASSERT_GT(coarse, 0);
+	ASSERT_LE(coarse, arap::Clock::monotonic());
+	ASSERT_GT(arap::Clock::realtimeCoarse(), arap::Clock::nanosecondsPerSecond * std::time(nullptr) - arap::Clock::nanosecondsPerSecond);
+}
+
+TEST(TimerWheel, MillisecondTicks)
+{
+	arap::BasicTimerWheel<ManualClock, 1000000> wheel;
+	ASSERT_EQ(-1, wheel.nextTimeoutMilliseconds());
+
+	wheel.add(std::chrono::milliseconds(250), nullptr);
+	wheel.add(std::chrono::microseconds(1500), nullptr);
+	wheel.add(1, nullptr);
+	ASSERT_EQ(2, wheel.nextTimeoutMilliseconds());
+	ASSERT_EQ(1, wheel.nextTimeout());
+
+	ManualClock::advance(std::chrono::milliseconds(2));
+	ASSERT_EQ(1, wheel.expire());
+	ASSERT_EQ(248, wheel.nextTimeoutMilliseconds());
+
+	ManualClock::advance(std::chrono::milliseconds(248));
+	ASSERT_EQ(1, wheel.expire());
+	ManualClock::advance(std::chrono::milliseconds(749));
+	ASSERT_EQ(0, wheel.expire());
+	ManualClock::advance(std::chrono::milliseconds(1));
+	ASSERT_EQ(1, wheel.expire());
+}
+
+TEST(TimerWheel, SlackCoalescesExpiries)
+{
+	arap::BasicTimerWheel<ManualClock, 1000000> wheel(0);
+	wheel.setSlack(std::chrono::milliseconds(100));
+
+	std::vector<time_t> fired;
+	time_t now = 0;
+	auto record = [&fired, &now]() { fired.push_back(now); };
+	wheel.add(std::chrono::milliseconds(1000), record);
+	wheel.add(std::chrono::milliseconds(1010), record);
+	wheel.add(std::chrono::milliseconds(1090), record);
+	wheel.add(std::chrono::milliseconds(1000), record, std::chrono::milliseconds(0));
+
+	size_t wakeUps = 0;
+	while (!wheel.empty())
+	{
+		now += static_cast<time_t>(wheel.nextTimeoutTicks());
+		ASSERT_GT(wheel.expire(now), 0);
+		wakeUps++;
+	}
+
+	// Never early, never later than the slack.
+	ASSERT_EQ(3, wakeUps);
+	ASSERT_EQ((std::vector<time_t>{1000, 1024, 1024, 1152}), fired);
+}
+
+TEST(TimerService, CallbackOnServiceThread)
+{
+	arap::TimerService service;
+	std::atomic<bool> fired(false);
+	std::atomic<bool> cancelledFired(false);
+
+	service.arm(std::chrono::milliseconds(20), [&fired]() { fired = true; });
+	auto cancelled = service.arm(std::chrono::milliseconds(20), [&cancelledFired]() { cancelledFired = true; });
+	service.cancel(cancelled);
+
+	for (uint32_t i = 0; i < 100 && !fired; i++)
+		usleep(10 * 1000);
+
+	ASSERT_TRUE(fired);
+	usleep(20 * 1000);
+	ASSERT_FALSE(cancelledFired);
+}
+
+TEST(TimerService, CompletionQueueDelivery)
+{
+	arap::TimerService service;
+	arap::TimerService::CompletionQueue completions;
+	auto caller = std::this_thread::get_id();
+	std::thread::id firedOn;
+
+	arap::MonotonicTimer measure(std::chrono::milliseconds(30));
+	service.arm(std::chrono::milliseconds(30), [&firedOn]() { firedOn = std::this_thread::get_id(); }, completions);
+
+	struct pollfd pollDescriptor = {completions.getFileDescriptor(), POLLIN, 0};
+	ASSERT_EQ(1, poll(&pollDescriptor, 1, 1000));
+	ASSERT_TRUE(measure.expired());
+	ASSERT_EQ(1, completions.dispatch());
+	ASSERT_EQ(caller, firedOn);
+	ASSERT_EQ(0, completions.dispatch());
+}
+
+// More commands from one callback than the queue holds, the service thread must not wait for itself.
+TEST(TimerService, ArmFromCallbackWithSmallQueue)
+{
+	arap::TimerService service(2);
+	std::atomic<uint32_t> fired(0);
+	std::atomic<bool> cancelledFired(false);
+
+	std::function<void()> rearm;
+	rearm = [&]()
+		{
+			if (fired.fetch_add(1) >= 3)
+				return;
+
+			for (uint32_t i = 0; i < 8; i++)
+				service.arm(std::chrono::milliseconds(1), []() {});
+
+			service.cancel(service.arm(std::chrono::milliseconds(1), [&cancelledFired]() { cancelledFired = true; }));
+			service.arm(std::chrono::milliseconds(1), rearm);
+		};
+	service.arm(std::chrono::milliseconds(1), rearm);
+
+	for (uint32_t i = 0; i < 100 && fired < 4; i++)
+		usleep(10 * 1000);
+
+	ASSERT_EQ(4, fired);
+	usleep(10 * 1000);
+	ASSERT_FALSE(cancelledFired);
+}
+
+TEST(ScheduleTimer, FixedSequence)
+{
+	arap::BasicScheduleTimer<ManualClock> timerTest({1, 2, 5});
+	ASSERT_EQ(0, timerTest.step());
+	ManualClock::advance(std::chrono::seconds(1));
+	ASSERT_TRUE(timerTest.expired());
+
+	timerTest.reset();
+	ASSERT_EQ(1, timerTest.step());
+	ASSERT_EQ(2, timerTest.nextTimeout());
+	ManualClock::advance(std::chrono::seconds(2));
+	ASSERT_TRUE(timerTest.expired());
+
+	ManualClock::advance(std::chrono::seconds(1));
+	timerTest.restart();
+	ASSERT_EQ(5, timerTest.nextTimeout());
+	timerTest.restart();
+	ASSERT_EQ(2, timerTest.step());
+	ASSERT_EQ(5, timerTest.nextTimeout());
+
+	timerTest.rewind();
+	ASSERT_EQ(1, timerTest.nextTimeout());
+}
+
+TEST(ScheduleTimer, SingleAndEmptySchedule)
+{
+	arap::BasicScheduleTimer<ManualClock> timerTest;
+	ASSERT_FALSE(timerTest.expired());
+
+	timerTest.set(3);
+	ASSERT_EQ(3, timerTest.nextTimeout());
+	ManualClock::advance(std::chrono::seconds(3));
+	ASSERT_TRUE(timerTest.expired());
+	timerTest.reset();
+	ASSERT_EQ(3, timerTest.nextTimeout());
+
+	ASSERT_THROW(timerTest.set(std::vector<uint32_t>()), std::runtime_error);
+}
+
+TEST(ScheduleTimer, BackoffWithJitter)
+{
+	auto intervals = arap::ScheduleTimer::exponentialBackoff(1, 60, 8);
+	ASSERT_EQ(std::vector<uint32_t>({1, 2, 4, 8, 16, 32, 60, 60}), intervals);
+
+	arap::BasicScheduleTimer<ManualClock> first;
+	arap::BasicScheduleTimer<ManualClock> second;
+	first.seed(1);
+	second.seed(2);
+	first.setJitter(50);
+	second.setJitter(50);
+	first.set(intervals);
+	second.set(intervals);
+
+	bool differed = false;
+	for (auto interval : intervals)
+	{
+		auto base = static_cast<int64_t>(interval) * 1000000000;
+		ASSERT_LE(first.intervalNanoseconds(), base);
+		ASSERT_GE(first.intervalNanoseconds(), base / 2);
+		differed = differed || first.intervalNanoseconds() != second.intervalNanoseconds();
+
+		first.restart();
+		second.restart();
+	}
+
+	ASSERT_TRUE(differed);
+
+	// The longest interval takes the whole range of the jitter as well.
+	const auto longest = std::numeric_limits<uint32_t>::max();
+	arap::BasicScheduleTimer<ManualClock> longTimer;
+	longTimer.seed(3);
+	longTimer.setJitter(100);
+	longTimer.set(longest);
+
+	int64_t shortest = std::numeric_limits<int64_t>::max();
+	for (int i = 0; i < 20; i++)
+	{
+		ASSERT_LE(longTimer.intervalNanoseconds(), static_cast<int64_t>(longest) * 1000000000);
+		shortest = std::min(shortest, longTimer.intervalNanoseconds());
+		longTimer.restart();
+	}
+
+	ASSERT_LT(shortest, static_cast<int64_t>(longest) * 1000000000 / 2);
+}